@@ -0,0 +1,295 @@
+#include "analysis_cache.h"
+
+#include <util/platform.h>
+
+#include <stdio.h>
+
+#include <algorithm>
+
+// Bump whenever the file layout or the meaning of AnalyzeResult changes,
+// files with another version are ignored and rewritten on the next store
+static const uint32_t CacheMagic = 0x43415345; // "ESAC"
+static const uint32_t CacheVersion = 3;
+
+static const size_t MaxEntries = 128;
+static const uint32_t MaxInstructions = 64;
+// Runner-ups past these are dropped, the poll loop seldom gets to them
+static const uint32_t MaxCandidates = 16;
+
+// Game code is loaded right after the exception vectors at 0x80000400
+static const size_t FingerprintStart = 0x400 / sizeof(uint32_t);
+static const size_t FingerprintLength = 0x10000 / sizeof(uint32_t);
+
+static uint64_t Fnv1a(const uint8_t *data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+template<typename T> static void put(std::vector<uint8_t> &buf, T val)
+{
+	const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&val);
+	buf.insert(buf.end(), bytes, bytes + sizeof(val));
+}
+
+static void putSymbols(std::vector<uint8_t> &buf,
+		       const std::vector<MIPS::LocatedSymbol> &symbols)
+{
+	put(buf, static_cast<uint32_t>(symbols.size()));
+	for (const auto &symbol : symbols) {
+		put(buf, static_cast<uint32_t>(symbol.symbol));
+		put(buf, symbol.address);
+		put(buf, static_cast<uint32_t>(symbol.confidence));
+	}
+}
+
+static void
+putCandidates(std::vector<uint8_t> &buf,
+	      const std::vector<MIPS::ControllerPadsCandidate> &candidates)
+{
+	uint32_t count = std::min<uint32_t>(
+		static_cast<uint32_t>(candidates.size()), MaxCandidates);
+	put(buf, count);
+	for (uint32_t i = 0; i < count; i++) {
+		const auto &candidate = candidates[i];
+		put(buf, candidate.address);
+		put(buf, static_cast<int32_t>(
+				 candidate.interpretedInstructionsOffset));
+		put(buf, static_cast<uint32_t>(candidate.confidence));
+		put(buf, static_cast<int32_t>(candidate.score));
+		put(buf, static_cast<uint32_t>(
+				 candidate.interpretedInstructions.size()));
+		for (uint32_t inst : candidate.interpretedInstructions)
+			put(buf, inst);
+	}
+}
+
+template<typename T> static bool get(FILE *file, T &val)
+{
+	return 1 == fread(&val, sizeof(val), 1, file);
+}
+
+static bool
+getCandidates(FILE *file,
+	      std::vector<MIPS::ControllerPadsCandidate> &candidates)
+{
+	uint32_t count;
+	if (!get(file, count) || count > MaxCandidates)
+		return false;
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t address, confidence, size;
+		int32_t offset, score;
+		if (!get(file, address) || !get(file, offset) ||
+		    !get(file, confidence) || !get(file, score) ||
+		    !get(file, size) || offset < 0 ||
+		    confidence > MIPS::CONFIDENCE_GUESSED ||
+		    size > MaxInstructions)
+			return false;
+
+		std::vector<uint32_t> instructions(size);
+		if (size != fread(instructions.data(), sizeof(uint32_t), size,
+				  file))
+			return false;
+
+		candidates.push_back(
+			{address, offset, std::move(instructions),
+			 static_cast<MIPS::Confidence>(confidence), score});
+	}
+	return true;
+}
+
+AnalysisCache::AnalysisCache(std::string path) : path_(std::move(path))
+{
+	load();
+}
+
+uint64_t AnalysisCache::fingerprint(const std::vector<uint32_t> &ram)
+{
+	if (ram.size() < FingerprintStart + FingerprintLength)
+		return 0;
+
+	return Fnv1a(reinterpret_cast<const uint8_t *>(&ram[FingerprintStart]),
+		     FingerprintLength * sizeof(uint32_t));
+}
+
+std::optional<MIPS::AnalyzeResult>
+AnalysisCache::find(uint64_t fingerprint, const std::vector<uint32_t> &ram)
+{
+	std::lock_guard<std::mutex> lck(mutex_);
+	for (auto &entry : entries_) {
+		if (entry.fingerprint != fingerprint)
+			continue;
+
+		// Same check 'Emulator::feedInputs' runs on every poll
+		const MIPS::AnalyzeResult &result = entry.result;
+		size_t off = static_cast<size_t>(
+			result.interpretedInstructionsOffset);
+		size_t size = result.interpretedInstructions.size();
+		if (off + size > ram.size() ||
+		    !std::equal(result.interpretedInstructions.begin(),
+				result.interpretedInstructions.end(),
+				ram.begin() + off))
+			return std::nullopt;
+
+		entry.lastUsed = ++clock_;
+		return result;
+	}
+
+	return std::nullopt;
+}
+
+void AnalysisCache::store(uint64_t fingerprint,
+			  const MIPS::AnalyzeResult &result)
+{
+	if (result.interpretedInstructionsOffset < 0 ||
+	    result.interpretedInstructions.size() > MaxInstructions)
+		return;
+
+	std::lock_guard<std::mutex> lck(mutex_);
+	auto it = std::find_if(entries_.begin(), entries_.end(),
+			       [&](const Entry &entry) {
+				       return entry.fingerprint == fingerprint;
+			       });
+	if (it != entries_.end()) {
+		it->result = result;
+		it->lastUsed = ++clock_;
+	} else {
+		if (entries_.size() >= MaxEntries) {
+			auto lru = std::min_element(
+				entries_.begin(), entries_.end(),
+				[](const Entry &l, const Entry &r) {
+					return l.lastUsed < r.lastUsed;
+				});
+			entries_.erase(lru);
+		}
+		entries_.push_back({fingerprint, ++clock_, result});
+	}
+
+	save();
+}
+
+void AnalysisCache::load()
+{
+	FILE *file = os_fopen(path_.c_str(), "rb");
+	if (!file)
+		return;
+
+	uint32_t magic, version, count;
+	if (!get(file, magic) || !get(file, version) || !get(file, count) ||
+	    magic != CacheMagic || version != CacheVersion) {
+		fclose(file);
+		return;
+	}
+
+	// A truncated or corrupted entry drops it and everything after it
+	count = std::min<uint32_t>(count, MaxEntries);
+	for (uint32_t i = 0; i < count; ++i) {
+		Entry entry{};
+		int32_t offset, pads;
+		uint32_t size;
+		if (!get(file, entry.fingerprint) ||
+		    !get(file, entry.lastUsed) || !get(file, offset) ||
+		    !get(file, pads) || !get(file, size) ||
+		    size > MaxInstructions || offset < 0)
+			break;
+
+		std::vector<uint32_t> instructions(size);
+		if (size != fread(instructions.data(), sizeof(uint32_t), size,
+				  file))
+			break;
+
+		uint32_t symbolCount;
+		if (!get(file, symbolCount) || symbolCount > MIPS::SymbolCount)
+			break;
+
+		std::vector<MIPS::LocatedSymbol> symbols;
+		for (uint32_t s = 0; s < symbolCount; s++) {
+			uint32_t symbol, address, confidence;
+			if (!get(file, symbol) || !get(file, address) ||
+			    !get(file, confidence) ||
+			    symbol >= MIPS::SymbolCount ||
+			    confidence > MIPS::CONFIDENCE_GUESSED)
+				break;
+
+			symbols.push_back(
+				{static_cast<MIPS::Symbol>(symbol), address,
+				 static_cast<MIPS::Confidence>(confidence)});
+		}
+		if (symbols.size() != symbolCount)
+			break;
+
+		int32_t margin;
+		std::vector<MIPS::ControllerPadsCandidate> candidates;
+		if (!get(file, margin) || !getCandidates(file, candidates))
+			break;
+
+		uint64_t checksum;
+		if (!get(file, checksum))
+			break;
+
+		entry.result = {offset, std::move(instructions), pads,
+				std::move(symbols), std::move(candidates),
+				margin};
+		std::vector<uint8_t> buf;
+		put(buf, entry.fingerprint);
+		put(buf, entry.lastUsed);
+		put(buf, offset);
+		put(buf, pads);
+		put(buf, size);
+		for (uint32_t inst : entry.result.interpretedInstructions)
+			put(buf, inst);
+		putSymbols(buf, entry.result.symbols);
+		put(buf, margin);
+		putCandidates(buf, entry.result.controllerPadsCandidates);
+		if (checksum != Fnv1a(buf.data(), buf.size()))
+			break;
+
+		clock_ = std::max(clock_, entry.lastUsed);
+		entries_.push_back(std::move(entry));
+	}
+
+	fclose(file);
+}
+
+void AnalysisCache::save()
+{
+	std::vector<uint8_t> buf;
+	put(buf, CacheMagic);
+	put(buf, CacheVersion);
+	put(buf, static_cast<uint32_t>(entries_.size()));
+	for (const auto &entry : entries_) {
+		const MIPS::AnalyzeResult &result = entry.result;
+		size_t start = buf.size();
+		put(buf, entry.fingerprint);
+		put(buf, entry.lastUsed);
+		put(buf, static_cast<int32_t>(
+				 result.interpretedInstructionsOffset));
+		put(buf, static_cast<int32_t>(result.gControllerPads));
+		put(buf, static_cast<uint32_t>(
+				 result.interpretedInstructions.size()));
+		for (uint32_t inst : result.interpretedInstructions)
+			put(buf, inst);
+		putSymbols(buf, result.symbols);
+		put(buf, static_cast<int32_t>(result.controllerPadsMargin));
+		putCandidates(buf, result.controllerPadsCandidates);
+		put(buf, Fnv1a(buf.data() + start, buf.size() - start));
+	}
+
+	// Write aside and swap so a crash mid-write never leaves a torn file
+	std::string tmpPath = path_ + ".tmp";
+	FILE *file = os_fopen(tmpPath.c_str(), "wb");
+	if (!file)
+		return;
+
+	bool written = buf.size() == fwrite(buf.data(), 1, buf.size(), file);
+	written = 0 == fclose(file) && written;
+	if (!written || 0 != os_rename(tmpPath.c_str(), path_.c_str()))
+		os_unlink(tmpPath.c_str());
+}
+
+AnalysisCache *gAnalysisCache = nullptr;
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "mips_analyzer.h"
+
+#include <stdint.h>
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Remembers analysis results between sessions so relaunching a game that was
+// already analyzed skips 'MIPS::analyze'. Results are keyed by a fingerprint
+// of the code that is loaded first and are only handed out again if their
+// interpreted instructions are still in place in RAM.
+class AnalysisCache {
+public:
+	explicit AnalysisCache(std::string path);
+
+	AnalysisCache &operator=(const AnalysisCache &) = delete;
+	AnalysisCache(const AnalysisCache &) = delete;
+
+	static uint64_t fingerprint(const std::vector<uint32_t> &ram);
+
+	std::optional<MIPS::AnalyzeResult>
+	find(uint64_t fingerprint, const std::vector<uint32_t> &ram);
+	void store(uint64_t fingerprint, const MIPS::AnalyzeResult &result);
+
+private:
+	struct Entry {
+		uint64_t fingerprint;
+		uint64_t lastUsed;
+		MIPS::AnalyzeResult result;
+	};
+
+	void load();
+	void save();
+
+	std::mutex mutex_;
+	std::string path_;
+	std::vector<Entry> entries_;
+	uint64_t clock_ = 0;
+};
+
+extern AnalysisCache *gAnalysisCache;
@@ -1,9 +1,13 @@
 #include "emulator.h"
 
+#include "analysis_cache.h"
+#include "signature_files.h"
+
 #include <psapi.h>
 
 #include <algorithm>
 #include <cctype>
+#include <iterator>
 #include <vector>
 
 Emulator::Emulator() : thread_(&Emulator::work, this) {}
@@ -177,13 +181,42 @@ void Emulator::scanProcessRAM()
 			       nullptr))
 		return;
 
-	analyzeResult_ = MIPS::analyze(ram);
-	if (!analyzeResult_)
-		return;
+	fingerprint_ = AnalysisCache::fingerprint(ram);
+	if (gAnalysisCache)
+		analyzeResult_ = gAnalysisCache->find(fingerprint_, ram);
+
+	if (!analyzeResult_) {
+		MIPS::AnalyzeOptions options;
+		options.signatures = gSignatures;
+		analyzeResult_ = MIPS::analyze(ram, options);
+		if (!analyzeResult_)
+			return;
+
+		if (gAnalysisCache)
+			gAnalysisCache->store(fingerprint_, *analyzeResult_);
+	}
 
 	ramPtrBase_ = ramPtrBase;
 }
 
+// Whether the code that stored the candidate is still where it was analyzed,
+// nothing if RAM cannot be read at all
+std::optional<bool>
+Emulator::verifyCandidate(const MIPS::ControllerPadsCandidate &candidate)
+{
+	std::vector<uint32_t> verifier(
+		candidate.interpretedInstructions.size());
+	if (!ReadProcessMemory(process_,
+			       ramPtrBase_ +
+				       candidate.interpretedInstructionsOffset *
+					       sizeof(uint32_t),
+			       verifier.data(),
+			       verifier.size() * sizeof(uint32_t), nullptr))
+		return std::nullopt;
+
+	return verifier == candidate.interpretedInstructions;
+}
+
 int32_t Emulator::feedInputs()
 {
 	msToWait_ = 15;
@@ -192,38 +225,84 @@ int32_t Emulator::feedInputs()
 		return 0;
 	}
 
-	std::vector<uint32_t> verifier;
-	verifier.reserve(analyzeResult_->interpretedInstructions.size());
-	if (!ReadProcessMemory(
-		    process_,
-		    ramPtrBase_ +
-			    analyzeResult_->interpretedInstructionsOffset *
-				    sizeof(uint32_t),
-		    verifier.data(),
-		    analyzeResult_->interpretedInstructions.size() *
-			    sizeof(uint32_t),
-		    nullptr)) {
-		markRAMDead();
-		return 0;
-	}
+	// A candidate whose code is gone or whose pads keep reading as garbage
+	// was a bad pick, the runner-ups are tried before analyzing RAM again
+	const auto &candidates = analyzeResult_->controllerPadsCandidates;
+	while (padsCandidate_ < candidates.size()) {
+		const MIPS::ControllerPadsCandidate &candidate =
+			candidates[padsCandidate_];
+		auto verified = verifyCandidate(candidate);
+		if (!verified) {
+			markRAMDead();
+			return 0;
+		}
+		if (!*verified) {
+			nextPadsCandidate();
+			continue;
+		}
 
-	if (0 != memcmp(verifier.data(),
-			analyzeResult_->interpretedInstructions.data(),
-			analyzeResult_->interpretedInstructions.size() *
-				sizeof(uint32_t))) {
-		markRAMDead();
-		return 0;
+		uint32_t pads[MIPS::ControllerPadsWords];
+		if (!ReadProcessMemory(process_,
+				       ramPtrBase_ +
+					       (candidate.address & 0xffffff),
+				       pads, sizeof(pads), nullptr)) {
+			markRAMDead();
+			return 0;
+		}
+
+		// Zeroed memory is plausible too, a runner-up only replaces the
+		// candidates ahead of it once it reads some input
+		bool live = std::any_of(
+			std::begin(pads), std::end(pads),
+			[](uint32_t word) { return word != 0; });
+		if (!MIPS::PlausibleControllerPads(pads) ||
+		    (padsCandidate_ != 0 && !live)) {
+			if (++badPolls_ < MaxBadPolls)
+				return 0;
+
+			nextPadsCandidate();
+			continue;
+		}
+
+		badPolls_ = 0;
+		if (padsCandidate_ != 0)
+			promotePadsCandidate();
+		return static_cast<int32_t>(pads[0]);
 	}
 
-	uint32_t inputs;
-	if (!ReadProcessMemory(process_,
-			       ramPtrBase_ + (analyzeResult_->gControllerPads &
-					      0xffffff),
-			       &inputs, sizeof(inputs), nullptr)) {
-		return 0;
+	markRAMDead();
+	return 0;
+}
+
+void Emulator::nextPadsCandidate()
+{
+	padsCandidate_++;
+	badPolls_ = 0;
+}
+
+// Moves the runner-up inputs are read from to the front so it is tried first
+// when the same game is found again
+void Emulator::promotePadsCandidate()
+{
+	auto &candidates = analyzeResult_->controllerPadsCandidates;
+	std::rotate(candidates.begin(), candidates.begin() + padsCandidate_,
+		    candidates.begin() + padsCandidate_ + 1);
+	padsCandidate_ = 0;
+
+	const MIPS::ControllerPadsCandidate &best = candidates[0];
+	analyzeResult_->interpretedInstructionsOffset =
+		best.interpretedInstructionsOffset;
+	analyzeResult_->interpretedInstructions = best.interpretedInstructions;
+	analyzeResult_->gControllerPads = static_cast<int>(best.address);
+	for (auto &symbol : analyzeResult_->symbols) {
+		if (symbol.symbol == MIPS::SYMBOL_CONTROLLER_PADS) {
+			symbol.address = best.address;
+			symbol.confidence = best.confidence;
+		}
 	}
 
-	return inputs;
+	if (gAnalysisCache)
+		gAnalysisCache->store(fingerprint_, *analyzeResult_);
 }
 
 void Emulator::work()
@@ -260,4 +339,6 @@ void Emulator::markRAMDead()
 {
 	ramPtrBase_ = nullptr;
 	analyzeResult_.reset();
+	padsCandidate_ = 0;
+	badPolls_ = 0;
 }
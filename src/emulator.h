@@ -25,7 +25,11 @@ private:
 
 	void searchProcess();
 	void scanProcessRAM();
+	std::optional<bool>
+	verifyCandidate(const MIPS::ControllerPadsCandidate &candidate);
 	int32_t feedInputs();
+	void nextPadsCandidate();
+	void promotePadsCandidate();
 
 	void markProcessDead();
 	void markRAMDead();
@@ -46,6 +50,15 @@ private:
 	BOOL processIs64Bit_ = false;
 	uint8_t *ramPtrBase_ = nullptr;
 	std::optional<MIPS::AnalyzeResult> analyzeResult_;
+	// Of the RAM 'analyzeResult_' was found for, to store it again
+	uint64_t fingerprint_ = 0;
+	// Index of the gControllerPads candidate inputs are read from
+	size_t padsCandidate_ = 0;
+	// Polls in a row its pads read as garbage, or as zeroes for a runner-up
+	// that never read any input. Games clear them on reset so it is only
+	// dropped after 'MaxBadPolls' of them.
+	static const int MaxBadPolls = 30;
+	int badPolls_ = 0;
 	int msToWait_ = 1;
 
 	bool running_ = true;
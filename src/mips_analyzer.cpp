@@ -1,231 +1,67 @@
 #include "mips_analyzer.h"
+#include "mips_callgraph.h"
 #include "mips_converter.h"
+#include "mips_dataflow.h"
 #include "mips_decompiler.h"
 #include "mips_instruction.h"
 #include "mips_interpreter.h"
+#include "mips_predecode.h"
+#include "mips_signatures.h"
+#include "mips_symbols.h"
+#include "mips_xref.h"
 
 #include <stdint.h>
 
-#include <set>
-#include <string>
-#include <sstream>
+#include <algorithm>
+#include <chrono>
 #include <vector>
-#include <iomanip>
 
 namespace MIPS {
 
-struct MaskPair {
-	uint32_t val;
-	uint32_t mask;
-
-	MaskPair(uint32_t val, uint32_t mask) : val(val), mask(mask) {}
-
-	std::string toString() const
+// Appends a phase to the stats every lap and copies the interpreter counters,
+// does nothing without stats
+class PhaseClock {
+public:
+	explicit PhaseClock(AnalyzeStats *stats)
+		: stats_(stats), start_(std::chrono::steady_clock::now())
 	{
-		std::ostringstream stream;
-		stream << std::hex << std::showbase << "0x" << val << ", 0x"
-		       << mask;
-		return stream.str();
 	}
-};
-
-static std::vector<int>
-IndicesOf(const std::vector<uint32_t> &arrayToSearchThrough,
-	  const MaskPair *patternToFind, size_t patternToFindSize)
-{
-	std::vector<int> ret;
-
-	if (patternToFindSize > arrayToSearchThrough.size())
-		return ret;
-
-	for (size_t i = 0; i <= arrayToSearchThrough.size() - patternToFindSize;
-	     ++i) {
-		bool found = true;
-		for (size_t j = 0; j < patternToFindSize; ++j) {
-			uint32_t data = arrayToSearchThrough[i + j];
-			uint32_t expectedAfterMasking = patternToFind[j].val;
-			uint32_t mask = patternToFind[j].mask;
-			uint32_t maskedData = data & (~mask);
-			uint32_t leftoverData = data & mask;
-
-			if (maskedData != expectedAfterMasking ||
-			    (mask != 0 && leftoverData == 0)) {
-				found = false;
-				break;
-			}
-		}
 
-		if (found) {
-			ret.push_back(static_cast<int>(i));
-		}
+	void lap(const char *name, size_t candidates, size_t found)
+	{
+		if (!stats_)
+			return;
+
+		auto now = std::chrono::steady_clock::now();
+		std::chrono::duration<double, std::milli> elapsed = now - start_;
+		stats_->phases.push_back(
+			{name, elapsed.count(), candidates, found});
+		start_ = now;
 	}
 
-	return ret;
-}
-
-static std::vector<int>
-IndicesOf(const std::vector<uint32_t> &arrayToSearchThrough,
-	  const uint32_t *patternToFind, size_t patternToFindSize)
-{
-	std::vector<int> ret;
-
-	if (patternToFindSize > arrayToSearchThrough.size())
-		return ret;
-
-	for (size_t i = 0; i <= arrayToSearchThrough.size() - patternToFindSize;
-	     ++i) {
-		bool found = true;
-		for (size_t j = 0; j < patternToFindSize; ++j) {
-			if (arrayToSearchThrough[i + j] != patternToFind[j]) {
-				found = false;
-				break;
-			}
-		}
+	void interpreted(const Interpreter &interpreter)
+	{
+		if (!stats_)
+			return;
 
-		if (found) {
-			ret.push_back(static_cast<int>(i));
-		}
+		stats_->decodeCacheHits = interpreter.decodeCacheHits;
+		stats_->decodeCacheMisses = interpreter.decodeCacheMisses;
 	}
 
-	return ret;
-}
-
-static std::vector<int>
-FindAll(const std::vector<uint32_t> &arrayToSearchThrough, uint32_t val)
-{
-	std::vector<int> list;
+	void argument(const KnownValue &value)
+	{
+		if (!stats_)
+			return;
 
-	for (size_t i = 0; i < arrayToSearchThrough.size(); ++i) {
-		if (arrayToSearchThrough[i] == val) {
-			list.push_back(static_cast<int>(i));
-		}
+		if (value.confidence == CONFIDENCE_GUESSED)
+			stats_->argumentsInterpreted++;
+		else
+			stats_->argumentsPropagated++;
 	}
 
-	return list;
-}
-
-static const uint32_t OsGetCount[] = {0x40024800, 0x03E00008, 0x00000000};
-
-static const struct MaskPair OsDisableInt[] = {
-	{0x40006000,
-	 0x001F0000}, // MFC0     T0, Status              MFC0     __, Status
-	{0x2400FFFE,
-	 0x001F0000}, // ADDIU    AT, R0, 0xFFFE          ADDIU    __, R0, 0xFFFE
-	{0x00000024,
-	 0x03FFF800}, // AND      T1, T0, AT              AND      __, __, __
-	{0x40806000,
-	 0x001F0000}, // MTC0     T1, Status              MTC0     __, Status
-	{0x30020001,
-	 0x03E00000}, // ANDI     V0, T0, 0x0001          ANDI     V0, __, 0x0001
-};
-
-static const struct MaskPair OsRestoreInt[] = {
-	{0x40006000,
-	 0x001F0000}, // MFC0     T0, Status              MFC0     __, Status
-	{0x00040025,
-	 0x03E0F800}, // OR       T0, T0, A0              OR       __, __, A0
-	{0x40806000,
-	 0x001F0000}, // MTC0     T0, Status              MTC0     __, Status
-	{0x00000000, 0x00000000}, // NOP                              NOP
-	{0x00000000, 0x00000000}, // NOP                              NOP
-	{0x03E00008,
-	 0x00000000}, // JR       RA                      JR       RA
-	{0x00000000, 0x00000000}, // NOP                              NOP
-};
-
-static const struct MaskPair OsWritebackDCache[] = {
-	{0x00000023,
-	 0x03FFF800}, // SUBU     T0, T0, T2              SUBU     __, __, __
-	{0xBC190000,
-	 0x03E00000}, // CACHE    (D, IIndexLoadData), T0, 0x0000 CACHE    (D, IIndexLoadData), __, 0x0000
-	{0x0000002B,
-	 0x03FFF800}, // SLTU     AT, T0, T1              SLTU     __, __, __
-	{0x1400FFFD,
-	 0x03E00000}, // BNE      R0, 0xFFFFFFF4(AT)      BNE      R0, 0xFFFFFFF4(__)
-	{0x24000010,
-	 0x03FF0000}, // ADDIU    T0, T0, 0x0010          ADDIU    __, __, 0x0010
-	{0x03E00008,
-	 0x00000000}, // JR       RA                      JR       RA
-	{0x00000000, 0x00000000}, // NOP                              NOP
-	{0x3C008000,
-	 0x001F0000}, // LUI      T0, 0x8000              LUI      __, 0x8000
-	{0x00000021,
-	 0x03FFF800}, // ADDU     T1, T0, T3              ADDU     __, __, __
-	{0x2400FFF0,
-	 0x03FF0000}, // ADDIU    T1, T1, 0xFFF0          ADDIU    __, __, 0xFFF0
-	{0xBC010000,
-	 0x03E00000}, // CACHE    (D), T0, 0x0000         CACHE    (D), __, 0x0000
-	{0x0000002B,
-	 0x03FFF800}, // SLTU     AT, T0, T1              SLTU     __, __, __
-	{0x1400FFFD,
-	 0x03E00000}, // BNE      R0, 0xFFFFFFF4(AT)      BNE      R0, 0xFFFFFFF4(__)
-	{0x24000010,
-	 0x03FF0000}, // ADDIU    T0, T0, 0x0010          ADDIU    __, __, 0x0010
-	{0x03E00008,
-	 0x00000000}, // JR       RA                      JR       RA
-	{0x00000000, 0x00000000}, // NOP                              NOP
-};
-
-static const struct MaskPair OsInvalDCache[] = {
-	{0x00000023,
-	 0x03FFF800}, // SUBU     T0, T0, T2              SUBU     __, __, __
-	{0xBC150000,
-	 0x03E00000}, // CACHE    (D, CacheBarrier), T0, 0x0000 CACHE    (D, CacheBarrier), __, 0x0000
-	{0x0000002B,
-	 0x03FFF800}, // SLTU     AT, T0, T1              SLTU     __, __, __
-	{0x1000000E,
-	 0x03E00000}, // BEQ      R0, 0x38(AT)            BEQ      R0, 0x38(__)
-	{0x00000000, 0x00000000}, // NOP                              NOP
-	{0x24000010,
-	 0x03FF0000}, // ADDIU    T0, T0, 0x0010          ADDIU    __, __, 0x0010
-	{0x3000000F,
-	 0x03FF0000}, // ANDI     T2, T1, 0x000F          ANDI     __, __, 0x000F
-	{0x10000006,
-	 0x03E00000}, // BEQ      R0, 0x18(T2)            BEQ      R0, 0x18(__)
-	{0x00000000, 0x00000000}, // NOP                              NOP
-	{0x00000023,
-	 0x03FFF800}, // SUBU     T1, T1, T2              SUBU     __, __, __
-	{0xBC150010,
-	 0x03E00000}, // CACHE    (D, CacheBarrier), T1, 0x0040 CACHE    (D, CacheBarrier), __, 0x0040
-	{0x0000002B,
-	 0x03FFF800}, // SLTU     AT, T1, T0              SLTU     __, __, __
-	{0x14000005,
-	 0x03E00000}, // BNE      R0, 0x14(AT)            BNE      R0, 0x14(__)
-	{0x00000000, 0x00000000}, // NOP                              NOP
-	{0xBC110000,
-	 0x03E00000}, // CACHE    (D, IHitInvalidate), T0, 0x0000 CACHE    (D, IHitInvalidate), __, 0x0000
-	{0x0000002B,
-	 0x03FFF800}, // SLTU     AT, T0, T1              SLTU     __, __, __
-	{0x1400FFFD,
-	 0x03E00000}, // BNE      R0, 0xFFFFFFF4(AT)      BNE      R0, 0xFFFFFFF4(__)
-	{0x24000010,
-	 0x03FF0000}, // ADDIU    T0, T0, 0x0010          ADDIU    __, __, 0x0010
-	{0x03E00008,
-	 0x00000000}, // JR       RA                      JR       RA
-	{0x00000000, 0x00000000}, // NOP                              NOP
-	{0x3C008000,
-	 0x001F0000}, // LUI      T0, 0x8000              LUI      __, 0x8000
-	{0x00000021,
-	 0x03FFF800}, // ADDU     T1, T0, T3              ADDU     __, __, __
-	{0x2400FFF0,
-	 0x03FF0000}, // ADDIU    T1, T1, 0xFFF0          ADDIU    __, __, 0xFFF0
-	{0xBC010000,
-	 0x03E00000}, // CACHE    (D), T0, 0x0000         CACHE    (D), __, 0x0000
-	{0x0000002B,
-	 0x03FFF800}, // SLTU     AT, T0, T1              SLTU     __, __, __
-	{0x1400FFFD,
-	 0x03E00000}, // BNE      R0, 0xFFFFFFF4(AT)      BNE      R0, 0xFFFFFFF4(__)
-	{0x24000010,
-	 0x03FF0000}, // ADDIU    T0, T0, 0x0010          ADDIU    __, __, 0x0010
-	{0x03E00008,
-	 0x00000000}, // JR       RA                      JR       RA
-	{0x00000000, 0x00000000}, // NOP                              NOP
-};
-
-static const struct MaskPair GPRSetup[] = {
-	{0x3c1c0000, 0x0000ffff}, // LUI GP, 0x____
-	{0x03E00008, 0x00000000}, // JR RA
-	{0x279c0000, 0x0000ffff}, // ADDIU GP, GP, ____
+private:
+	AnalyzeStats *stats_;
+	std::chrono::steady_clock::time_point start_;
 };
 
 static bool IsVAddr(uint32_t addr)
@@ -240,316 +76,559 @@ static bool IsVAddr(uint32_t addr)
 	return true;
 }
 
-static std::vector<int> FindAllJumpsTo(const std::vector<uint32_t> &mem,
-				       int pos)
+const char *SymbolName(Symbol symbol)
+{
+	static const char *const sNames[SymbolCount] = {
+		"gControllerPads",
+		"__osContPifRam",
+		"__osViIntrCount",
+		"osMemSize",
+	};
+	return sNames[symbol];
+}
+
+// Sorted and unique so call targets can be looked up in it
+static std::vector<int> SortedEntries(std::vector<int> entries)
 {
-	Instruction jmpInst;
-	jmpInst.cmd = CMD_JAL;
-	jmpInst.jump = static_cast<uint32_t>(4 * pos);
-	uint32_t jmpInstVal = ToUInt(jmpInst);
-	return FindAll(mem, jmpInstVal);
+	std::sort(entries.begin(), entries.end());
+	entries.erase(std::unique(entries.begin(), entries.end()),
+		      entries.end());
+	return entries;
 }
 
-static std::set<int> FindAllJumpsTo(const std::vector<uint32_t> &mem,
-				    const std::vector<int> &poses)
+// JALs to any of 'poses' in ascending order. Sites of every target are
+// already sorted and distinct targets never share a site, merging them is
+// all it takes.
+static std::vector<int> FindAllJumpsTo(const CallIndex &calls,
+				       const std::vector<int> &poses)
 {
-	std::set<int> jumps;
-	for (int pos : poses) {
-		std::vector<int> jumpResult = FindAllJumpsTo(mem, pos);
-		jumps.insert(jumpResult.begin(), jumpResult.end());
+	std::vector<int> targets = SortedEntries(poses);
+	size_t count = 0;
+	for (int pos : targets)
+		count += calls.callsTo(pos).size();
+
+	std::vector<int> jumps;
+	jumps.reserve(count);
+	for (int pos : targets) {
+		Sites sites = calls.callsTo(pos);
+		size_t sorted = jumps.size();
+		jumps.insert(jumps.end(), sites.begin(), sites.end());
+		std::inplace_merge(jumps.begin(), jumps.begin() + sorted,
+				   jumps.end());
 	}
 	return jumps;
 }
 
-static std::set<int> FindAllJumpsTo(const std::vector<uint32_t> &mem,
-				    const uint32_t *data, size_t dataSize)
+static bool CallsAnyOf(const CallGraph &graph, int site,
+		       const std::vector<int> &entries)
 {
-	std::vector<int> indices = IndicesOf(mem, data, dataSize);
-	return FindAllJumpsTo(mem, indices);
+	return std::binary_search(entries.begin(), entries.end(),
+				  graph.callee(site));
 }
 
-static std::set<int> FindAllJumpsTo(const std::vector<uint32_t> &mem,
-				    const MaskPair *data, size_t dataSize)
+// Function 'site' is in if its stack frame setup is less than 'maxDistance'
+// words before it, -1 otherwise
+static int FunctionNear(const CallGraph &graph, int site, int maxDistance)
 {
-	std::vector<int> indices = IndicesOf(mem, data, dataSize);
-	return FindAllJumpsTo(mem, indices);
+	int function = graph.functionAt(site);
+	if (function < 0 || site - graph.start(function) >= maxDistance)
+		return -1;
+
+	return function;
 }
 
-static int CountJumps(const std::vector<uint32_t> &mem, int regionStart,
-		      int regionEnd)
+// Calls 'function' makes from the one at 'from' up to the first one to
+// 'entries' at most 'maxLength' words later, nothing if there is none
+static Sites CallsUpTo(const CallGraph &graph, int function, int from,
+		       int maxLength, const std::vector<int> &entries)
 {
-	std::set<uint32_t> jumps;
-	for (int i = regionStart; i <= regionEnd; i++) {
-		Instruction inst = decodeInstruction(mem[i]);
-		if (inst.cmd == CMD_JAL) {
-			jumps.emplace(*inst.jump);
-		}
+	Sites region =
+		graph.callsFrom(function).between(from, from + maxLength);
+	for (const int *site = region.begin(); site != region.end(); site++) {
+		if (CallsAnyOf(graph, *site, entries))
+			return {region.begin(), site + 1};
 	}
-	return static_cast<int>(jumps.size());
+	return {};
 }
 
-static uint32_t GetSecondArgumentToJAL(const std::vector<uint32_t> &mem,
-				       uint32_t off)
+static bool AnyCallsAnyOf(const CallGraph &graph, Sites sites,
+			  const std::vector<int> &entries)
 {
-	uint32_t vaddr = 0x80000000 | (off << 2);
-	Interpreter interpreter(mem);
-	const uint32_t InstructionsToInterpretCount = 16;
-	const uint32_t BytesToInterpretCount = InstructionsToInterpretCount
-					       << 2;
-	interpreter.pc = vaddr - BytesToInterpretCount;
-
-	for (uint32_t i = 0;
-	     i < InstructionsToInterpretCount + 2 /*JAL + delay slot*/; i++) {
-		std::optional<Instruction> inst = interpreter.getInstruction();
-		if (inst.has_value())
-			interpreter.execute(inst.value());
-	}
-
-	return static_cast<uint32_t>(interpreter.gpr[static_cast<int>(REG_A1)]);
+	return std::any_of(sites.begin(), sites.end(), [&](int site) {
+		return CallsAnyOf(graph, site, entries);
+	});
 }
 
-static std::tuple<uint32_t, std::set<uint32_t>>
-GetThirdArgumentToJALAndCheckWordStore(uint32_t gp,
-				       const std::vector<uint32_t> &mem,
-				       uint32_t off)
+// Distinct targets of the calls, there are only a few of them so comparing
+// against the earlier ones is cheaper than collecting them into a container
+static int CountCallees(const CallGraph &graph, Sites sites)
 {
-	uint32_t vaddr = 0x80000000 | (off << 2);
-	Interpreter interpreter(mem);
-	constexpr uint32_t InstructionsToInterpretCount = 20;
-	constexpr uint32_t BytesToInterpretCount = InstructionsToInterpretCount
-						   << 2;
-	interpreter.pc = vaddr - BytesToInterpretCount;
-	interpreter.gpr[static_cast<int>(REG_GP)] = gp;
-
-	std::optional<Instruction> inst;
-
-	std::set<uint32_t> wordsStored;
-	for (uint32_t i = 0;
-	     i < InstructionsToInterpretCount + 2 /*JAL + delay slot*/; i++) {
-		inst = interpreter.getInstruction();
-		if (inst.has_value()) {
-			interpreter.execute(inst.value());
-			if (inst.value().cmd == CMD_SW) {
-				uint32_t wordStored =
-					interpreter.gpr[static_cast<int>(
-						*inst->rt)];
-				if (wordStored != 0) {
-					wordsStored.insert(wordStored);
-				}
-			}
-		}
+	int callees = 0;
+	for (const int *site = sites.begin(); site != sites.end(); site++) {
+		if (std::none_of(sites.begin(), site, [&](int earlier) {
+			    return graph.callee(earlier) == graph.callee(*site);
+		    }))
+			callees++;
 	}
+	return callees;
+}
+
+// Instructions the interpreter may take to get from the start of a window to
+// its JAL, branches and loops make the path longer than the window
+static const uint32_t InterpretBudget = 0x40;
+
+// Propagates constants to the JAL and only interprets the code before it when
+// that does not find A1. Nothing if that code does not reach the JAL either.
+static std::optional<KnownValue>
+GetSecondArgumentToJAL(const std::vector<uint32_t> &mem,
+		       Interpreter &interpreter, CallState &call, uint32_t off)
+{
+	const uint32_t InstructionsToInterpretCount = 16;
+	PropagateToCall(mem, static_cast<int>(off),
+			InstructionsToInterpretCount, std::nullopt, call);
+	if (call.regs[REG_A1].has_value())
+		return call.regs[REG_A1];
 
-	uint32_t a2 = interpreter.gpr[static_cast<int>(REG_A2)];
-	return std::make_tuple(a2, wordsStored);
+	// From where propagation started, past any jump before the JAL
+	uint32_t vaddr = 0x80000000 | (off << 2);
+	interpreter.reset(0x80000000 | (static_cast<uint32_t>(call.start) << 2),
+			  vaddr);
+	interpreter.run(InterpretBudget);
+	if (interpreter.pc != vaddr)
+		return std::nullopt;
+
+	interpreter.run(2 /*JAL + delay slot*/);
+	if (interpreter.faults & FAULT_FETCH)
+		return std::nullopt;
+
+	int32_t a1 = interpreter.gpr[static_cast<int>(REG_A1)];
+	return KnownValue{static_cast<uint32_t>(a1), CONFIDENCE_GUESSED};
 }
 
-static bool IsPrologInstruction(const Instruction &inst)
+// Sorts the words in place and drops zeroes and duplicates
+static void KeepDistinctNonZero(std::vector<uint32_t> &words)
 {
-	return inst.cmd == CMD_ADDIU && inst.rt == REG_SP &&
-	       inst.rs == REG_SP && inst.imm < 0;
+	words.erase(std::remove(words.begin(), words.end(), 0U), words.end());
+	std::sort(words.begin(), words.end());
+	words.erase(std::unique(words.begin(), words.end()), words.end());
 }
 
-static int FindProlog(const std::vector<uint32_t> &mem, int start,
-		      int maxScanLength)
+// Fills 'wordsStored' with the distinct non zero words stored by SW in
+// ascending order, it is cleared first and keeps its capacity between calls.
+// Like 'GetSecondArgumentToJAL' both come from the interpreter when constant
+// propagation does not find A2.
+static std::optional<KnownValue> GetThirdArgumentToJALAndCheckWordStore(
+	const std::vector<uint32_t> &mem, Interpreter &interpreter,
+	CallState &call, std::optional<uint32_t> gp, uint32_t off,
+	std::vector<uint32_t> &wordsStored)
 {
-	for (int i = start - 1; i > start - maxScanLength; i--) {
-		Instruction inst = decodeInstruction(mem[i]);
-		if (IsPrologInstruction(inst)) {
-			return i;
-		}
+	constexpr uint32_t InstructionsToInterpretCount = 20;
+	wordsStored.clear();
+	PropagateToCall(mem, static_cast<int>(off),
+			InstructionsToInterpretCount, gp, call);
+	if (call.regs[REG_A2].has_value()) {
+		for (const KnownValue &stored : call.stored)
+			wordsStored.push_back(stored.value);
+		KeepDistinctNonZero(wordsStored);
+		return call.regs[REG_A2];
 	}
 
-	throw std::invalid_argument("Failed to detect the prolog");
+	// From where propagation started, past any jump before the JAL
+	uint32_t vaddr = 0x80000000 | (off << 2);
+	interpreter.reset(0x80000000 | (static_cast<uint32_t>(call.start) << 2),
+			  vaddr);
+	interpreter.gpr[static_cast<int>(REG_GP)] = gp.value_or(0);
+	interpreter.run(InterpretBudget, &wordsStored);
+	if (interpreter.pc != vaddr)
+		return std::nullopt;
+
+	interpreter.run(2 /*JAL + delay slot*/, &wordsStored);
+	if (interpreter.faults & FAULT_FETCH)
+		return std::nullopt;
+
+	KeepDistinctNonZero(wordsStored);
+	int32_t a2 = interpreter.gpr[static_cast<int>(REG_A2)];
+	return KnownValue{static_cast<uint32_t>(a2), CONFIDENCE_GUESSED};
 }
 
-template<typename T>
-static std::set<T> GetViewBetween(const std::set<T> &s, const T &lower,
-				  const T &upper)
+// Words before the prolog may already belong to the function, but control
+// never falls through a JR RA and its delay slot into it
+static void AddEntryCandidates(const DecodedRAM &code, int prologWords,
+			       int prologAt, std::vector<int> &entries)
 {
-	std::set<T> result;
-	auto it_lower = s.lower_bound(lower);
-	auto it_upper = s.upper_bound(upper);
-	for (auto it = it_lower; it != it_upper; ++it) {
-		result.insert(*it);
+	for (int i = 0; i <= prologWords && prologAt - i >= 0; i++) {
+		int entry = prologAt - i;
+		entries.push_back(entry);
+		if (entry >= 2 && code.returns().test(entry - 2))
+			break;
 	}
-
-	return result;
 }
 
-#define ARR_SZ(x) x, sizeof(x) / sizeof(*(x))
+// Errors osContGetReadData leaves in OSContPad::errno
+static const uint8_t ContNoResponseError = 0x8;
+static const uint8_t ContOverrunError = 0x4;
 
-std::optional<AnalyzeResult> analyze(const std::vector<uint32_t> &mem)
+bool PlausibleControllerPads(const uint32_t *pads)
 {
-	std::set<int> osGetCountJumps = FindAllJumpsTo(mem, ARR_SZ(OsGetCount));
-	std::vector<int> disableOff;
-	for (int off : IndicesOf(mem, ARR_SZ(OsDisableInt))) {
-		disableOff.push_back(off);
-		// sometimes there is a bit of a prologue before
-		// TODO: Verify there are no tiny functions in [off-4, off] area
-		disableOff.push_back(off - 4);
+	const size_t PadBytes = 6;
+	const size_t ErrnoByte = 4;
+	for (size_t pad = 0; pad < 4; pad++) {
+		size_t byte = pad * PadBytes + ErrnoByte;
+		uint8_t error = static_cast<uint8_t>(pads[byte / 4] >>
+						     (24 - 8 * (byte % 4)));
+		if (error != 0 && error != ContNoResponseError &&
+		    error != ContOverrunError)
+			return false;
 	}
+	return true;
+}
 
-	std::set<int> osDisableIntJumps = FindAllJumpsTo(mem, disableOff);
-	std::set<int> osRestoreIntJumps =
-		FindAllJumpsTo(mem, ARR_SZ(OsRestoreInt));
+// OSContPad and OSContStatus arrays of 4 controllers in bytes
+static const uint32_t ControllerPadsSize = 0x18;
+static const uint32_t ControllerStatusSize = 0x10;
+
+// Points a gControllerPads candidate scores for everything that fits it
+static const int ScoreExactStatus = 2;
+static const int ScoreAssumedStatus = 1;
+static const int ScorePerStoringCall = 2;
+static const int ScoreNearStatus = 1;
+static const int ScoreGpConsistent = 1;
+static const int ScorePlausiblePads = 3;
+
+// Games declare the pads and the status together
+static const uint32_t NearStatusDistance = 0x100;
+
+struct PadsCandidate {
+	uint32_t address;
+	uint32_t status;
+	// osContInit JAL the address was stored before
+	int site;
+	Confidence confidence;
+};
 
-	// Discover all osGetTime functions that look like calls to 3 functions
-	std::vector<int> osGetTimes;
-	for (int regionStart : osDisableIntJumps) {
-		try {
-			const int MaxRegionLength = 0x18;
-			auto view =
-				GetViewBetween(osRestoreIntJumps, regionStart,
-					       regionStart + MaxRegionLength);
-			if (view.empty())
-				continue;
+static bool InGpWindow(std::optional<uint32_t> gp, uint32_t addr)
+{
+	return gp && addr - (*gp - 0x8000) < 0x10000;
+}
 
-			int regionEnd = *view.begin();
-			view = GetViewBetween(osGetCountJumps, regionStart,
-					      regionEnd);
-			if (view.empty())
-				continue;
+static uint32_t Distance(uint32_t l, uint32_t r)
+{
+	return l < r ? r - l : l - r;
+}
 
-			// Must be only calls to __osDisableInt + osGetCount + __osRestoreInt
-			if (3 != CountJumps(mem, regionStart, regionEnd))
-				continue;
+// Score of 'candidate' or -1 if it cannot be an OSContPad array next to its
+// status. Every call to osContInit storing the same address adds to it. The
+// pads are read as whole words, by the probe here and by the emulator that
+// polls them, so 2 byte aligned arrays are not taken.
+static int ScoreControllerPads(const std::vector<uint32_t> &mem,
+			       std::optional<uint32_t> gp,
+			       const PadsCandidate &candidate,
+			       const std::vector<PadsCandidate> &candidates)
+{
+	uint32_t pads = candidate.address;
+	uint32_t status = candidate.status;
+	size_t off = (pads & 0xffffff) / sizeof(uint32_t);
+	if (!IsVAddr(pads) || !IsVAddr(status) || (pads & 3) ||
+	    off + ControllerPadsWords > mem.size())
+		return -1;
+	if (pads < status + ControllerStatusSize &&
+	    status < pads + ControllerPadsSize)
+		return -1;
+
+	int score = 0;
+	if (candidate.confidence == CONFIDENCE_EXACT)
+		score += ScoreExactStatus;
+	else if (candidate.confidence == CONFIDENCE_ASSUMED)
+		score += ScoreAssumedStatus;
+
+	score += ScorePerStoringCall *
+		 static_cast<int>(std::count_if(
+			 candidates.begin(), candidates.end(),
+			 [&](const PadsCandidate &other) {
+				 return other.address == pads;
+			 }));
+
+	if (Distance(pads, status) < NearStatusDistance)
+		score += ScoreNearStatus;
+	if (gp && InGpWindow(gp, pads) == InGpWindow(gp, status))
+		score += ScoreGpConsistent;
+
+	// The dump is a snapshot of the running game, the pads in it have to
+	// look like what osContGetReadData wrote
+	if (PlausibleControllerPads(&mem[off]))
+		score += ScorePlausiblePads;
+	return score;
+}
 
-			osGetTimes.push_back(
-				FindProlog(mem, regionStart, 0x10));
-		} catch (...) {
-		}
+std::optional<AnalyzeResult> analyze(const std::vector<uint32_t> &mem,
+				     const AnalyzeOptions &options)
+{
+	// All signatures are matched in a single sweep, every JAL in RAM is
+	// indexed and every word decoded once, the passes below only query the
+	// results
+	PhaseClock clock(options.stats);
+	const SignatureDatabase &database = options.signatures
+						    ? *options.signatures
+						    : SignatureDatabase::builtIn();
+	std::vector<std::vector<int>> signatures =
+		database.match(mem, options.serial);
+	size_t signaturesFound = 0;
+	for (const auto &found : signatures)
+		signaturesFound += found.size();
+	clock.lap("signatures", mem.size(), signaturesFound);
+
+	CallIndex calls(mem, options.serial);
+	clock.lap("xref", mem.size(), calls.sitesCount());
+
+	DecodedRAM code(mem, options.serial);
+	clock.lap("predecode", mem.size(), code.codeCount());
+
+	CallGraph graph(code, calls);
+	clock.lap("callgraph", calls.sitesCount(), graph.functionsCount());
+
+	// Entries of every target are sorted and unique already
+	const std::vector<int> &osGetCounts = signatures[TARGET_OS_GET_COUNT];
+	const std::vector<int> &osRestoreInts =
+		signatures[TARGET_OS_RESTORE_INT];
+	std::vector<int> osDisableIntJumps =
+		FindAllJumpsTo(calls, signatures[TARGET_OS_DISABLE_INT]);
+
+	// Discover all osGetTime: right after its prolog it calls
+	// __osDisableInt, osGetCount and __osRestoreInt and nothing else
+	std::vector<int> osGetTimes;
+	for (int disableCall : osDisableIntJumps) {
+		int function = FunctionNear(graph, disableCall, 0x10);
+		if (function < 0)
+			continue;
+
+		const int MaxRegionLength = 0x18;
+		Sites region = CallsUpTo(graph, function, disableCall,
+					 MaxRegionLength, osRestoreInts);
+		if (region.empty() ||
+		    !AnyCallsAnyOf(graph, region, osGetCounts))
+			continue;
+
+		// Must be only calls to __osDisableInt + osGetCount + __osRestoreInt
+		if (3 != CountCallees(graph, region))
+			continue;
+
+		osGetTimes.push_back(graph.start(function));
 	}
 
-	std::vector<int> writebackDCacheOff;
-	for (int off : IndicesOf(mem, ARR_SZ(OsWritebackDCache))) {
-		writebackDCacheOff.push_back(off - 0xd);
-	}
-	std::set<int> osWritebackDCacheJumps =
-		FindAllJumpsTo(mem, writebackDCacheOff);
-
-	std::vector<int> invalOff;
-	for (int off : IndicesOf(mem, ARR_SZ(OsInvalDCache))) {
-		// sometimes there is an extra NOP inserted
-		invalOff.push_back(off - 0xe);
-		invalOff.push_back(off - 0xf);
-	}
-	std::set<int> osInvalDCacheJumps = FindAllJumpsTo(mem, invalOff);
+	clock.lap("osGetTime", osDisableIntJumps.size(), osGetTimes.size());
+
+	std::vector<int> osWritebackDCacheJumps =
+		FindAllJumpsTo(calls, signatures[TARGET_OS_WRITEBACK_DCACHE]);
+	const std::vector<int> &osInvalDCaches =
+		signatures[TARGET_OS_INVAL_DCACHE];
 
-	// Discover all __osSiRawStartDma that looks like calls to 3 functions with the 4th being after the prolog
+	// Discover all __osSiRawStartDma: it calls 3 functions, the 4th call
+	// is after the prolog
 	std::vector<int> osSiRawStartDmas;
-	for (int regionStart : osWritebackDCacheJumps) {
-		try {
-			const int MaxRegionLength = 0x18;
-			auto view =
-				GetViewBetween(osInvalDCacheJumps, regionStart,
-					       regionStart + MaxRegionLength);
-			if (view.empty())
-				continue;
+	for (int writebackCall : osWritebackDCacheJumps) {
+		int function = FunctionNear(graph, writebackCall, 0x20);
+		if (function < 0)
+			continue;
+
+		const int MaxRegionLength = 0x18;
+		Sites region = CallsUpTo(graph, function, writebackCall,
+					 MaxRegionLength, osInvalDCaches);
+		if (region.empty())
+			continue;
+
+		// Must be only calls to osWritebackDCache + osVirtualToPhysical + osInvalDCache
+		if (3 != CountCallees(graph, region))
+			continue;
+
+		AddEntryCandidates(code, database.prologWords(),
+				   graph.start(function), osSiRawStartDmas);
+	}
 
-			int regionEnd = *view.begin();
+	clock.lap("__osSiRawStartDma", osWritebackDCacheJumps.size(),
+		  osSiRawStartDmas.size());
 
-			// Must be only calls to osWritebackDCache + osVirtualToPhysical + osInvalDCache
-			if (3 != CountJumps(mem, regionStart, regionEnd))
-				continue;
+	std::vector<int> osGetTimeJumps = FindAllJumpsTo(calls, osGetTimes);
+	std::vector<int> osSiRawStartDmaEntries =
+		SortedEntries(osSiRawStartDmas);
 
-			int prologAt = FindProlog(mem, regionStart, 0x20);
-			for (int i = 0; i < 5; i++)
-				osSiRawStartDmas.push_back(prologAt - i);
-		} catch (...) {
-		}
-	}
-
-	std::set<int> osGetTimeJumps = FindAllJumpsTo(mem, osGetTimes);
-	std::set<int> osSiRawStartDmaJumps =
-		FindAllJumpsTo(mem, osSiRawStartDmas);
+	// Shared by every candidate below, resetting it only clears the stack
+	// pages the previous candidate wrote to. Only used for the arguments
+	// constant propagation cannot find.
+	Interpreter interpreter(mem);
+	CallState call;
 
 	// Discover all osContInit; we do not need the functions themselves but __osContPifRam passed to __osSiRawStartDma
 	// We know that 'osContInit' calls 'osGetTime' and '__osSiRawStartDma' 2 times
 	std::vector<int> osContInts;
-	for (int regionStart : osGetTimeJumps) {
-		try {
-			const int MaxRegionLength = 0x80;
-			auto view = GetViewBetween(
-				osSiRawStartDmaJumps, regionStart,
-				regionStart + MaxRegionLength);
-			if (view.size() != 2)
+	std::vector<KnownValue> osContPifRamCandidates;
+	for (int getTimeCall : osGetTimeJumps) {
+		int function = FunctionNear(graph, getTimeCall, 0x20);
+		if (function < 0)
+			continue;
+
+		const int MaxRegionLength = 0x80;
+		Sites region = graph.callsFrom(function).between(
+			getTimeCall, getTimeCall + MaxRegionLength);
+		int dmaCalls[2];
+		size_t dmaCallCount = 0;
+		for (int site : region) {
+			if (!CallsAnyOf(graph, site, osSiRawStartDmaEntries))
 				continue;
+			if (dmaCallCount < 2)
+				dmaCalls[dmaCallCount] = site;
+			dmaCallCount++;
+		}
+		if (dmaCallCount != 2)
+			continue;
+
+		// Find the argument to both JALs
+		uint32_t osContPifRams[2];
+		size_t osContPifRamCount = 0;
+		Confidence osContPifRamConfidence = CONFIDENCE_EXACT;
+		for (int jump : dmaCalls) {
+			auto pifRam = GetSecondArgumentToJAL(
+				mem, interpreter, call,
+				static_cast<uint32_t>(jump));
+			if (!pifRam.has_value())
+				break;
 
-			// Interpret the code around both JALs
-			std::vector<uint32_t> osContPifRams;
-			for (auto jump : view) {
-				osContPifRams.push_back(GetSecondArgumentToJAL(
-					mem, static_cast<uint32_t>(jump)));
-			}
+			clock.argument(pifRam.value());
+			osContPifRams[osContPifRamCount++] = pifRam->value;
+			osContPifRamConfidence = std::max(
+				osContPifRamConfidence, pifRam->confidence);
+		}
 
-			if (osContPifRams[0] != osContPifRams[1])
-				continue;
+		if (osContPifRamCount != 2)
+			continue;
 
-			uint32_t vosContPifRam = osContPifRams[0];
-			if (!IsVAddr(vosContPifRam))
-				continue;
+		if (osContPifRams[0] != osContPifRams[1])
+			continue;
 
-			int prologAt = FindProlog(mem, regionStart, 0x20);
-			for (int i = 0; i < 5; i++)
-				osContInts.push_back(prologAt - i);
-		} catch (...) {
-		}
+		uint32_t vosContPifRam = osContPifRams[0];
+		if (!IsVAddr(vosContPifRam))
+			continue;
+
+		osContPifRamCandidates.push_back(
+			{vosContPifRam, osContPifRamConfidence});
+		AddEntryCandidates(code, database.prologWords(),
+				   graph.start(function), osContInts);
 	}
 
-	std::vector<int> gprSetups = IndicesOf(mem, ARR_SZ(GPRSetup));
-	uint32_t gp = 0;
-	if (!gprSetups.empty()) {
+	clock.lap("osContInit", osGetTimeJumps.size(), osContInts.size());
+
+	const std::vector<int> &gprSetups = signatures[TARGET_GP_SETUP];
+	std::optional<uint32_t> gp;
+	// Entries of signatures from files may leave no room for the ADDIU
+	if (!gprSetups.empty() &&
+	    static_cast<size_t>(gprSetups[0]) + 2 < mem.size()) {
 		uint32_t gprOff = static_cast<uint32_t>(gprSetups[0]);
 		uint32_t gpHi = mem[gprOff] & 0xffff;
 		int16_t gpLo = static_cast<int16_t>(mem[gprOff + 2] & 0xffff);
 		gp = (gpHi << 16) + static_cast<uint32_t>(gpLo);
 	}
 
-	std::set<int> osContIntJumps = FindAllJumpsTo(mem, osContInts);
+	// Every other word stored before an osContInit call that receives a
+	// status stored there too may be gControllerPads
+	std::vector<int> osContIntJumps = FindAllJumpsTo(calls, osContInts);
+	std::vector<uint32_t> wordStores;
+	std::vector<PadsCandidate> candidates;
 	for (int osContIntJump : osContIntJumps) {
-		try {
-			auto [status, wordStores] =
-				GetThirdArgumentToJALAndCheckWordStore(
-					gp, mem,
-					static_cast<uint32_t>(osContIntJump));
-			if (wordStores.size() < 2)
-				continue;
+		auto third = GetThirdArgumentToJALAndCheckWordStore(
+			mem, interpreter, call, gp,
+			static_cast<uint32_t>(osContIntJump), wordStores);
+		if (!third.has_value())
+			continue;
+
+		clock.argument(third.value());
+		uint32_t status = third->value;
+		if (wordStores.size() < 2 ||
+		    !std::binary_search(wordStores.begin(), wordStores.end(),
+					status))
+			continue;
+
+		for (uint32_t stored : wordStores) {
+			if (stored != status)
+				candidates.push_back({stored, status,
+						      osContIntJump,
+						      third->confidence});
+		}
+	}
 
-			if (wordStores.find(status) == wordStores.end())
-				continue;
+	// Images have a handful of candidates, too few to pay for threads
+	std::vector<int> scores(candidates.size());
+	for (size_t i = 0; i < candidates.size(); i++)
+		scores[i] = ScoreControllerPads(mem, gp, candidates[i],
+						candidates);
+
+	// Best first, the one closest to its status and then the first one
+	// found wins a tie. Each address is kept once, where it scored best.
+	std::vector<size_t> order;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (scores[i] >= 0)
+			order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t l, size_t r) {
+		if (scores[l] != scores[r])
+			return scores[l] > scores[r];
+		return Distance(candidates[l].address, candidates[l].status) <
+		       Distance(candidates[r].address, candidates[r].status);
+	});
+
+	std::vector<ControllerPadsCandidate> ranked;
+	for (size_t i : order) {
+		const PadsCandidate &candidate = candidates[i];
+		if (std::any_of(ranked.begin(), ranked.end(),
+				[&](const ControllerPadsCandidate &better) {
+					return better.address ==
+					       candidate.address;
+				}))
+			continue;
+
+		// Calls at the very start of RAM get a shorter verifier
+		int regionEnd = candidate.site;
+		int regionStart = std::max(0, regionEnd - 20);
+		ranked.push_back({candidate.address, regionStart,
+				  std::vector<uint32_t>(
+					  mem.begin() + regionStart,
+					  mem.begin() + regionEnd),
+				  candidate.confidence, scores[i]});
+	}
 
-			wordStores.erase(status);
-			uint32_t cont = 0;
-			for (const auto &stored : wordStores) {
-				if (cont != 0) {
-					long long dist0 = std::abs(
-						static_cast<long long>(status) -
-						static_cast<long long>(stored));
-					long long dist1 = std::abs(
-						static_cast<long long>(status) -
-						static_cast<long long>(cont));
-					if (dist0 < dist1)
-						cont = stored;
-				} else {
-					cont = stored;
-				}
-			}
-
-			int regionEnd = osContIntJump;
-			int regionLength = 20;
-			int regionStart = regionEnd - regionLength;
-			std::vector<uint32_t> interpretedSegment(
-				mem.begin() + regionStart,
-				mem.begin() + regionStart + regionLength);
-
-			return AnalyzeResult{regionStart,
-					     std::move(interpretedSegment),
-					     static_cast<int>(cont)};
-		} catch (...) {
-		}
+	clock.lap("gControllerPads", candidates.size(), ranked.size());
+	clock.interpreted(interpreter);
+	if (ranked.empty())
+		return std::nullopt;
+
+	const ControllerPadsCandidate &best = ranked[0];
+	int margin = best.score - (ranked.size() > 1 ? ranked[1].score : 0);
+	// A tie is only broken by the distance to the status
+	Confidence padsConfidence = ranked.size() > 1 && margin == 0
+					    ? CONFIDENCE_GUESSED
+					    : best.confidence;
+	std::optional<AnalyzeResult> result = AnalyzeResult{};
+	result->interpretedInstructionsOffset =
+		best.interpretedInstructionsOffset;
+	result->interpretedInstructions = best.interpretedInstructions;
+	result->gControllerPads = static_cast<int>(best.address);
+	result->controllerPadsCandidates = std::move(ranked);
+	result->controllerPadsMargin = margin;
+
+	// The other symbols only query what was found so far
+	result->symbols.push_back({SYMBOL_CONTROLLER_PADS,
+				   static_cast<uint32_t>(result->gControllerPads),
+				   padsConfidence});
+	LocatorContext context{mem, code, graph, gp, osGetCounts,
+			       osContPifRamCandidates};
+	for (const SymbolLocator *locator : SymbolLocators()) {
+		auto address = locator->locate(context);
+		if (address)
+			result->symbols.push_back({locator->symbol(),
+						   address->value,
+						   address->confidence});
 	}
 
-	return std::nullopt;
+	clock.lap("symbols", SymbolLocators().size(),
+		  result->symbols.size() - 1);
+	return result;
 }
 }
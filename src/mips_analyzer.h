@@ -1,17 +1,102 @@
 #pragma once
 
+#include "mips_dataflow.h"
+
 #include <stdint.h>
 
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace MIPS {
 
+class SignatureDatabase;
+
+// Globals the analysis locates, gControllerPads is always found first
+enum Symbol {
+	SYMBOL_CONTROLLER_PADS,
+	SYMBOL_CONT_PIF_RAM,
+	SYMBOL_VI_RETRACE_COUNT,
+	SYMBOL_MEM_SIZE,
+	SymbolCount
+};
+
+const char *SymbolName(Symbol symbol);
+
+struct LocatedSymbol {
+	Symbol symbol;
+	uint32_t address;
+	Confidence confidence;
+};
+
+// OSContPad of all 4 controllers as osContGetReadData fills it, 6 bytes each
+static const size_t ControllerPadsWords = 6;
+
+// Whether 'pads' may hold the OSContPad array of a running game: the error of
+// every controller is one libultra reports. Zeroed memory passes, the game may
+// not have read the controllers yet.
+bool PlausibleControllerPads(const uint32_t *pads);
+
+// Address stored right before an osContInit call next to the controller status
+// it receives, any of them may be gControllerPads
+struct ControllerPadsCandidate {
+	uint32_t address;
+	// Words up to the osContInit call, they stay in place as long as the
+	// code that stores the address does
+	int interpretedInstructionsOffset;
+	std::vector<uint32_t> interpretedInstructions;
+	// Of the controller status the address was picked next to
+	Confidence confidence;
+	int score;
+};
+
 struct AnalyzeResult {
 	int interpretedInstructionsOffset;
 	std::vector<uint32_t> interpretedInstructions;
 	int gControllerPads;
+	// Every symbol that was found in the order of 'Symbol', gControllerPads
+	// included
+	std::vector<LocatedSymbol> symbols;
+	// Every scored candidate, best first. The first one is gControllerPads
+	// and its verifier above, the others are tried if it reads as garbage.
+	// A runner-up that works is moved to the front, the fields above and
+	// its symbol follow it and the margin stays as analyzed.
+	std::vector<ControllerPadsCandidate> controllerPadsCandidates;
+	// How much higher the best candidate scored than the runner-up, its
+	// whole score if there is none
+	int controllerPadsMargin = 0;
+};
+
+struct AnalyzePhase {
+	std::string name;
+	double milliseconds;
+	// Candidates the phase looked at and how many of them survived
+	size_t candidates;
+	size_t found;
+};
+
+struct AnalyzeStats {
+	std::vector<AnalyzePhase> phases;
+	// Instructions the interpreter took from or had to add to its decode
+	// cache while checking candidates
+	uint64_t decodeCacheHits = 0;
+	uint64_t decodeCacheMisses = 0;
+	// Call arguments constant propagation found and those it could not,
+	// which were taken from the interpreter instead
+	size_t argumentsPropagated = 0;
+	size_t argumentsInterpreted = 0;
+};
+
+struct AnalyzeOptions {
+	// Signature search and cross-referencing are split into RAM chunks
+	// processed on worker threads unless this is set. Results are the same.
+	bool serial = false;
+	// Receives per-phase timings and candidate counts when set
+	AnalyzeStats *stats = nullptr;
+	// Signatures to start from, 'SignatureDatabase::builtIn' if not set
+	const SignatureDatabase *signatures = nullptr;
 };
 
-std::optional<AnalyzeResult> analyze(const std::vector<uint32_t> &mem);
+std::optional<AnalyzeResult> analyze(const std::vector<uint32_t> &mem,
+				     const AnalyzeOptions &options = {});
 }
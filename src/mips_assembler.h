@@ -0,0 +1,107 @@
+#pragma once
+
+#include "mips_converter.h"
+#include "mips_instruction.h"
+#include "mips_scanner.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <optional>
+
+namespace MIPS {
+
+// One signature word, assembled at compile time. Fields the format of the
+// command has but that are not given are wildcards, written '__' in the
+// comments of the tables: the matcher takes any non-zero value there.
+//
+//   Asm(CMD_ADDIU).rs(REG_R0).imm(0xFFFE)         ADDIU    __, R0, 0xFFFE
+//   Asm(CMD_BNE).rt(REG_R0).off(-0xc)             BNE      R0, 0xFFFFFFF4(__)
+class Asm {
+public:
+	constexpr explicit Asm(Cmd cmd) : inst_() { inst_.cmd = cmd; }
+
+	constexpr Asm rs(Register reg) const
+	{
+		Asm ret = *this;
+		ret.inst_.rs = std::optional<Register>(reg);
+		return ret;
+	}
+	constexpr Asm rt(Register reg) const
+	{
+		Asm ret = *this;
+		ret.inst_.rt = std::optional<Register>(reg);
+		return ret;
+	}
+	constexpr Asm rd(Register reg) const
+	{
+		Asm ret = *this;
+		ret.inst_.rd = std::optional<Register>(reg);
+		return ret;
+	}
+	constexpr Asm shift(int sa) const
+	{
+		Asm ret = *this;
+		ret.inst_.shift = std::optional<int>(sa);
+		return ret;
+	}
+	constexpr Asm imm(int val) const
+	{
+		Asm ret = *this;
+		ret.inst_.imm = std::optional<short>(static_cast<short>(val));
+		return ret;
+	}
+	// In bytes like 'Instruction::off', branches count from the delay slot
+	constexpr Asm off(int bytes) const
+	{
+		Asm ret = *this;
+		ret.inst_.off = std::optional<int>(bytes);
+		return ret;
+	}
+	// In bytes like 'Instruction::jump'
+	constexpr Asm jump(uint32_t bytes) const
+	{
+		Asm ret = *this;
+		ret.inst_.jump = std::optional<uint32_t>(bytes);
+		return ret;
+	}
+	constexpr Asm cop0(Cop0Registers reg) const
+	{
+		Asm ret = *this;
+		ret.inst_.cop0 = std::optional<Cop0Registers>(reg);
+		return ret;
+	}
+	constexpr Asm cache(int op) const
+	{
+		Asm ret = *this;
+		ret.inst_.cache =
+			std::optional<CacheOp>(static_cast<CacheOp>(op));
+		return ret;
+	}
+
+	constexpr operator MaskPair() const
+	{
+		uint32_t wildcards = 0;
+		uint32_t val = Encode(inst_, wildcards);
+		return MaskPair(val, wildcards);
+	}
+
+private:
+	Instruction inst_;
+};
+
+// Whether 'words' encode to exactly the 'val, mask' pairs in 'expected'
+template<size_t N, size_t M>
+constexpr bool Assembles(const MaskPair (&words)[N],
+			 const uint32_t (&expected)[M])
+{
+	if (2 * N != M)
+		return false;
+	for (size_t i = 0; i < N; i++) {
+		if (words[i].val != expected[2 * i] ||
+		    words[i].mask != expected[2 * i + 1])
+			return false;
+	}
+	return true;
+}
+}
@@ -0,0 +1,46 @@
+#include "mips_callgraph.h"
+
+#include <algorithm>
+
+namespace MIPS {
+CallGraph::CallGraph(const DecodedRAM &code, const CallIndex &calls)
+	: code_(code), calls_(calls)
+{
+	// Every function is a prolog, then a scan to the next prolog or data
+	// word and over the JALs in between, all of them bitmap searches
+	const WordBitmap &prologs = code.prologs();
+	const WordBitmap &data = code.data();
+	const WordBitmap &jals = code.jals();
+	int size = static_cast<int>(code.size());
+	for (int start = prologs.findNext(0, size); start < size;) {
+		int next = prologs.findNext(start + 1, size);
+		int end = data.findNext(start + 1, next);
+
+		starts_.push_back(start);
+		ends_.push_back(end);
+		offsets_.push_back(static_cast<uint32_t>(sites_.size()));
+		for (int site = jals.findNext(start, end); site < end;
+		     site = jals.findNext(site + 1, end))
+			sites_.push_back(site);
+
+		start = next;
+	}
+	offsets_.push_back(static_cast<uint32_t>(sites_.size()));
+}
+
+int CallGraph::functionAt(int pos) const
+{
+	auto it = std::upper_bound(starts_.begin(), starts_.end(), pos);
+	if (it == starts_.begin())
+		return -1;
+
+	size_t function = static_cast<size_t>(it - starts_.begin()) - 1;
+	return pos < ends_[function] ? static_cast<int>(function) : -1;
+}
+
+Sites CallGraph::callsFrom(size_t function) const
+{
+	const int *sites = sites_.data();
+	return {sites + offsets_[function], sites + offsets_[function + 1]};
+}
+}
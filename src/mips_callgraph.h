@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mips_predecode.h"
+#include "mips_xref.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace MIPS {
+
+// Functions in RAM and the JALs between them. A function starts at its stack
+// frame setup and runs up to the next one or the first word that is not
+// code, so leaf functions without a frame are part of the function before
+// them. Calls made by every function are stored in CSR form: the JALs in
+// function 'f' are sites_[offsets_[f], offsets_[f + 1]) in ascending order.
+// Calls to a word come from the 'CallIndex' the graph is built on.
+class CallGraph {
+public:
+	// Keeps references to both, they have to outlive the graph
+	CallGraph(const DecodedRAM &code, const CallIndex &calls);
+
+	size_t functionsCount() const { return starts_.size(); }
+	size_t callsCount() const { return sites_.size(); }
+
+	// First word of 'function', its ADDIU SP, SP, -n
+	int start(size_t function) const { return starts_[function]; }
+	// Word after the last one of 'function'
+	int end(size_t function) const { return ends_[function]; }
+	// Function 'pos' is in or -1 if it is not in any
+	int functionAt(int pos) const;
+
+	// JALs in 'function'
+	Sites callsFrom(size_t function) const;
+	// JALs to 'pos' from anywhere in RAM
+	Sites callsTo(int pos) const { return calls_.callsTo(pos); }
+	// Word the JAL at 'site' goes to
+	int callee(int site) const
+	{
+		return static_cast<int>(code_.jumpTarget(site));
+	}
+
+private:
+	const DecodedRAM &code_;
+	const CallIndex &calls_;
+
+	std::vector<int> starts_;
+	std::vector<int> ends_;
+	std::vector<uint32_t> offsets_;
+	std::vector<int> sites_;
+};
+}
@@ -0,0 +1,188 @@
+#include "mips_classify.h"
+#include "mips_simd.h"
+#include "mips_types.h"
+
+#include <utility>
+
+namespace MIPS {
+// A word has the shape when 'word & mask' equals 'val'
+struct WordShape {
+	uint32_t mask;
+	uint32_t val;
+};
+
+static const WordShape sWordShapes[WordClassCount] = {
+	{0xFC000000, OP_JAL << 26},
+	{0xFFFF8000, (OP_ADDIU << 26) | (REG_SP << 21) | (REG_SP << 16) |
+			     0x8000},
+	{0xFFFFFFFF, (REG_RA << 21) | FUNCT_JR},
+	{0xFC000000, OP_LUI << 26},
+	{0xFC000000, static_cast<uint32_t>(OP_CACHE) << 26},
+	// MFC0 and MTC0 only differ in bit 23, Status is register 12
+	{0xFF60FFFF, (OP_COP0 << 26) | (12 << 11)},
+};
+
+// Up to 64 words, bits are shifted in from the last word down
+static void ClassifyBlockScalar(const uint32_t *words, size_t count,
+				uint64_t bits[WordClassCount])
+{
+	for (int c = 0; c < WordClassCount; c++)
+		bits[c] = 0;
+
+	for (size_t i = count; i-- > 0;) {
+		uint32_t word = words[i];
+		for (int c = 0; c < WordClassCount; c++) {
+			const WordShape &shape = sWordShapes[c];
+			bits[c] = (bits[c] << 1) |
+				  ((word & shape.mask) == shape.val);
+		}
+	}
+}
+
+static void StoreBlock(const uint64_t bits[WordClassCount], size_t block,
+		       uint64_t *const masks[WordClassCount])
+{
+	for (int c = 0; c < WordClassCount; c++)
+		masks[c][block] = bits[c];
+}
+
+static void ClassifyWordsScalar(const uint32_t *words, size_t count,
+				uint64_t *const masks[WordClassCount])
+{
+	uint64_t bits[WordClassCount];
+	for (size_t base = 0; base < count; base += 64) {
+		size_t blockCount = count - base < 64 ? count - base : 64;
+		ClassifyBlockScalar(words + base, blockCount, bits);
+		StoreBlock(bits, base / 64, masks);
+	}
+}
+
+#ifdef MIPS_SCANNER_X86
+// Vector kernels expand the loop over the classes at compile time so the
+// shapes become constants, the words are loaded once per block where there
+// are enough registers to hold them
+using Classes = std::make_index_sequence<WordClassCount>;
+
+// Hits for 16 words, saturating packs keep the compare results at 0 or -1
+// and in order so one movemask covers all of them
+static inline uint64_t HitsSSE2(const uint32_t *words, const WordShape &shape)
+{
+	const __m128i *vectors = reinterpret_cast<const __m128i *>(words);
+	const __m128i mask = _mm_set1_epi32(static_cast<int>(shape.mask));
+	const __m128i val = _mm_set1_epi32(static_cast<int>(shape.val));
+
+	__m128i hit0 = _mm_cmpeq_epi32(
+		_mm_and_si128(_mm_loadu_si128(vectors), mask), val);
+	__m128i hit1 = _mm_cmpeq_epi32(
+		_mm_and_si128(_mm_loadu_si128(vectors + 1), mask), val);
+	__m128i hit2 = _mm_cmpeq_epi32(
+		_mm_and_si128(_mm_loadu_si128(vectors + 2), mask), val);
+	__m128i hit3 = _mm_cmpeq_epi32(
+		_mm_and_si128(_mm_loadu_si128(vectors + 3), mask), val);
+	__m128i packed = _mm_packs_epi16(_mm_packs_epi32(hit0, hit1),
+					 _mm_packs_epi32(hit2, hit3));
+	return static_cast<uint32_t>(_mm_movemask_epi8(packed));
+}
+
+template<size_t... C>
+static void ClassifyBlockSSE2(const uint32_t *words, size_t block,
+			      uint64_t *const masks[WordClassCount],
+			      std::index_sequence<C...>)
+{
+	((masks[C][block] = HitsSSE2(words, sWordShapes[C]) |
+			    HitsSSE2(words + 16, sWordShapes[C]) << 16 |
+			    HitsSSE2(words + 32, sWordShapes[C]) << 32 |
+			    HitsSSE2(words + 48, sWordShapes[C]) << 48),
+	 ...);
+}
+
+// Hits for the 32 words in 'block', packs interleave the 128-bit lanes and
+// the permute puts the groups of 4 words back in order
+MIPS_TARGET_AVX2 static inline uint64_t HitsAVX2(const __m256i block[4],
+						 const WordShape &shape)
+{
+	const __m256i mask = _mm256_set1_epi32(static_cast<int>(shape.mask));
+	const __m256i val = _mm256_set1_epi32(static_cast<int>(shape.val));
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	__m256i hit0 = _mm256_cmpeq_epi32(_mm256_and_si256(block[0], mask),
+					  val);
+	__m256i hit1 = _mm256_cmpeq_epi32(_mm256_and_si256(block[1], mask),
+					  val);
+	__m256i hit2 = _mm256_cmpeq_epi32(_mm256_and_si256(block[2], mask),
+					  val);
+	__m256i hit3 = _mm256_cmpeq_epi32(_mm256_and_si256(block[3], mask),
+					  val);
+	__m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(hit0, hit1),
+					    _mm256_packs_epi32(hit2, hit3));
+	packed = _mm256_permutevar8x32_epi32(packed, order);
+	return static_cast<uint32_t>(_mm256_movemask_epi8(packed));
+}
+
+template<size_t... C>
+MIPS_TARGET_AVX2 static void
+ClassifyBlockAVX2(const uint32_t *words, size_t block,
+		  uint64_t *const masks[WordClassCount],
+		  std::index_sequence<C...>)
+{
+	const __m256i *vectors = reinterpret_cast<const __m256i *>(words);
+	const __m256i low[4] = {
+		_mm256_loadu_si256(vectors), _mm256_loadu_si256(vectors + 1),
+		_mm256_loadu_si256(vectors + 2),
+		_mm256_loadu_si256(vectors + 3)};
+	const __m256i high[4] = {_mm256_loadu_si256(vectors + 4),
+				 _mm256_loadu_si256(vectors + 5),
+				 _mm256_loadu_si256(vectors + 6),
+				 _mm256_loadu_si256(vectors + 7)};
+
+	((masks[C][block] = HitsAVX2(low, sWordShapes[C]) |
+			    HitsAVX2(high, sWordShapes[C]) << 32),
+	 ...);
+}
+
+static void ClassifyWordsSSE2(const uint32_t *words, size_t count,
+			      uint64_t *const masks[WordClassCount])
+{
+	size_t base = 0;
+	for (; base + 64 <= count; base += 64)
+		ClassifyBlockSSE2(words + base, base / 64, masks, Classes());
+
+	if (base < count) {
+		uint64_t bits[WordClassCount];
+		ClassifyBlockScalar(words + base, count - base, bits);
+		StoreBlock(bits, base / 64, masks);
+	}
+}
+
+MIPS_TARGET_AVX2 static void
+ClassifyWordsAVX2(const uint32_t *words, size_t count,
+		  uint64_t *const masks[WordClassCount])
+{
+	size_t base = 0;
+	for (; base + 64 <= count; base += 64)
+		ClassifyBlockAVX2(words + base, base / 64, masks, Classes());
+
+	if (base < count) {
+		uint64_t bits[WordClassCount];
+		ClassifyBlockScalar(words + base, count - base, bits);
+		StoreBlock(bits, base / 64, masks);
+	}
+}
+#endif
+
+void ClassifyWords(const uint32_t *words, size_t count,
+		   uint64_t *const masks[WordClassCount], ScanKernel kernel)
+{
+	if (kernel > BestScanKernel())
+		kernel = BestScanKernel();
+
+#ifdef MIPS_SCANNER_X86
+	if (kernel == SCAN_KERNEL_AVX2)
+		return ClassifyWordsAVX2(words, count, masks);
+	if (kernel == SCAN_KERNEL_SSE2)
+		return ClassifyWordsSSE2(words, count, masks);
+#endif
+
+	ClassifyWordsScalar(words, count, masks);
+}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "mips_scanner.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace MIPS {
+// Instruction shapes the analysis keys off, each one a fixed set of bits
+enum WordClass {
+	// JAL to anywhere
+	WORD_CLASS_JAL,
+	// ADDIU SP, SP, -n
+	WORD_CLASS_PROLOG,
+	// JR RA
+	WORD_CLASS_RETURN,
+	// LUI to any register
+	WORD_CLASS_LUI,
+	// CACHE of any kind
+	WORD_CLASS_CACHE,
+	// MFC0 or MTC0 of the Status register
+	WORD_CLASS_STATUS,
+	WordClassCount
+};
+
+// Sets bit 'i % 64' of 'masks[class][i / 64]' for every word 'i' of 'words'
+// that has the shape of the class and clears the others. Every mask holds
+// '(count + 63) / 64' words, bits past 'count' are cleared as well.
+// Vector kernels classify 4 or 8 words per instruction, kernels the CPU does
+// not support fall back to the best supported one and SCAN_KERNEL_SCALAR is
+// the reference implementation.
+void ClassifyWords(const uint32_t *words, size_t count,
+		   uint64_t *const masks[WordClassCount],
+		   ScanKernel kernel = BestScanKernel());
+}
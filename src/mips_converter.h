@@ -2,62 +2,271 @@
 
 #include "mips_instruction.h"
 
-#include <map>
+#include <array>
+#include <initializer_list>
+#include <stdexcept>
 
 namespace MIPS {
-static Cmd ToCmd(Op op)
+inline Cmd ToCmd(Op op)
 {
 	return (Cmd)(CMD_IMM | static_cast<Cmd>(op));
 }
 
-static Cmd ToCmd(Funct funct)
+inline Cmd ToCmd(Funct funct)
 {
 	return (Cmd)(CMD_REG | static_cast<Cmd>(funct));
 }
 
-static Cmd ToCmd(FunctImm functImm)
+inline Cmd ToCmd(FunctImm functImm)
 {
 	return (Cmd)(CMD_REGIMM | static_cast<Cmd>(functImm));
 }
 
-static Cmd ToCmd(Cop cop, int num)
+inline Cmd ToCmd(Cop cop, int num)
 {
 	return (Cmd)((num == 0 ? CMD_COP0 : CMD_COP1) | static_cast<Cmd>(cop));
 }
 
-static Op ToOp(Cmd cmd)
+inline Op ToOp(Cmd cmd)
 {
 	return static_cast<Op>(static_cast<int>(cmd) & 0xffffff);
 }
 
-static Funct ToFunct(Cmd cmd)
+inline Funct ToFunct(Cmd cmd)
 {
 	return static_cast<Funct>(static_cast<int>(cmd) & 0xffffff);
 }
 
-static FunctImm ToFunctImm(Cmd cmd)
+inline FunctImm ToFunctImm(Cmd cmd)
 {
 	return static_cast<FunctImm>(static_cast<int>(cmd) & 0xffffff);
 }
 
-Format ToFormat(Cmd cmd);
+template<typename T> struct CmdEntry {
+	Cmd cmd;
+	T value;
+};
 
-uint32_t ToUInt(Instruction inst);
+// Flat table indexed by Cmd, evaluated at compile time for constant entries
+template<typename T>
+constexpr std::array<T, CmdCount>
+MakeCmdTable(T fallback, std::initializer_list<CmdEntry<T>> entries)
+{
+	std::array<T, CmdCount> table{};
+	for (auto &value : table)
+		value = fallback;
+	for (const auto &entry : entries)
+		table[static_cast<uint32_t>(entry.cmd)] = entry.value;
+	return table;
+}
+
+// Formats of all supported commands, FORMAT_INVALID for the rest
+inline constexpr std::array<Format, CmdCount> gCmdFormats =
+	MakeCmdTable<Format>(FORMAT_INVALID, {
+		{CMD_NOP, FORMAT_NONE},
+
+		{CMD_ADDI, FORMAT_REGIMM_ST},
+		{CMD_ADDIU, FORMAT_REGIMM_ST},
+		{CMD_ANDI, FORMAT_REGIMM_ST},
+		{CMD_BEQ, FORMAT_REGOFF_ST},
+		{CMD_BEQL, FORMAT_REGOFF_ST},
+		{CMD_BGTZ, FORMAT_REGOFF_S},
+		{CMD_BGTZL, FORMAT_REGOFF_S},
+		{CMD_BLEZ, FORMAT_REGOFF_S},
+		{CMD_BLEZL, FORMAT_REGOFF_S},
+		{CMD_BNE, FORMAT_REGOFF_ST},
+		{CMD_BNEL, FORMAT_REGOFF_ST},
+		{CMD_DADDI, FORMAT_REGIMM_ST},
+		{CMD_DADDIU, FORMAT_REGIMM_ST},
+		{CMD_J, FORMAT_JUMP},
+		{CMD_JAL, FORMAT_JUMP},
+		{CMD_LB, FORMAT_REGOFF_ST},
+		{CMD_LBU, FORMAT_REGOFF_ST},
+		{CMD_LD, FORMAT_REGOFF_ST},
+		{CMD_LDL, FORMAT_REGOFF_ST},
+		{CMD_LDR, FORMAT_REGOFF_ST},
+		{CMD_LH, FORMAT_REGOFF_ST},
+		{CMD_LHU, FORMAT_REGOFF_ST},
+		{CMD_LL, FORMAT_REGOFF_ST},
+		{CMD_LLD, FORMAT_REGOFF_ST},
+		{CMD_LUI, FORMAT_REGIMM_T},
+		{CMD_LW, FORMAT_REGOFF_ST},
+		{CMD_LWL, FORMAT_REGOFF_ST},
+		{CMD_LWR, FORMAT_REGOFF_ST},
+		{CMD_LWU, FORMAT_REGOFF_ST},
+		{CMD_ORI, FORMAT_REGIMM_ST},
+		{CMD_SB, FORMAT_REGOFF_ST},
+		{CMD_SC, FORMAT_REGOFF_ST},
+		{CMD_SCD, FORMAT_REGOFF_ST},
+		{CMD_SD, FORMAT_REGOFF_ST},
+		{CMD_SDL, FORMAT_REGOFF_ST},
+		{CMD_SDR, FORMAT_REGOFF_ST},
+		{CMD_SH, FORMAT_REGOFF_ST},
+		{CMD_SLTI, FORMAT_REGIMM_ST},
+		{CMD_SLTIU, FORMAT_REGIMM_ST},
+		{CMD_SW, FORMAT_REGOFF_ST},
+		{CMD_SWL, FORMAT_REGOFF_ST},
+		{CMD_SWR, FORMAT_REGOFF_ST},
+		{CMD_XORI, FORMAT_REGIMM_ST},
+
+		{CMD_ADD, FORMAT_REG_STD},
+		{CMD_ADDU, FORMAT_REG_STD},
+		{CMD_AND, FORMAT_REG_STD},
+		//            { CMD_BREAK, FORMAT_REG_STD },
+		{CMD_DADD, FORMAT_REG_STD},
+		{CMD_DADDU, FORMAT_REG_STD},
+		{CMD_DDIV, FORMAT_REG_ST},
+		{CMD_DDIVU, FORMAT_REG_ST},
+		{CMD_DIV, FORMAT_REG_ST},
+		{CMD_DIVU, FORMAT_REG_ST},
+		{CMD_DMULT, FORMAT_REG_ST},
+		{CMD_DMULTU, FORMAT_REG_ST},
+		{CMD_DSLL, FORMAT_REG_TDA},
+		{CMD_DSLL32, FORMAT_REG_TDA},
+		{CMD_DSLLV, FORMAT_REG_STD},
+		{CMD_DSRA, FORMAT_REG_TDA},
+		{CMD_DSRA32, FORMAT_REG_TDA},
+		{CMD_DSRAV, FORMAT_REG_STD},
+		{CMD_DSRL, FORMAT_REG_TDA},
+		{CMD_DSRL32, FORMAT_REG_TDA},
+		{CMD_DSRLV, FORMAT_REG_STD},
+		{CMD_DSUB, FORMAT_REG_STD},
+		{CMD_DSUBU, FORMAT_REG_STD},
+		{CMD_JALR, FORMAT_REG_SD},
+		{CMD_JR, FORMAT_REG_S},
+		{CMD_MFHI, FORMAT_REG_D},
+		{CMD_MFLO, FORMAT_REG_D},
+		{CMD_MTHI, FORMAT_REG_S},
+		{CMD_MTLO, FORMAT_REG_S},
+		{CMD_MULT, FORMAT_REG_ST},
+		{CMD_MULTU, FORMAT_REG_ST},
+		{CMD_NOR, FORMAT_REG_STD},
+		{CMD_OR, FORMAT_REG_STD},
+		{CMD_SLL, FORMAT_REG_TDA},
+		{CMD_SLLV, FORMAT_REG_STD},
+		{CMD_SLT, FORMAT_REG_STD},
+		{CMD_SLTU, FORMAT_REG_STD},
+		{CMD_SRA, FORMAT_REG_TDA},
+		{CMD_SRAV, FORMAT_REG_STD},
+		{CMD_SRL, FORMAT_REG_TDA},
+		{CMD_SRLV, FORMAT_REG_STD},
+		{CMD_SUB, FORMAT_REG_STD},
+		{CMD_SUBU, FORMAT_REG_STD},
+		{CMD_SYNC, FORMAT_REG_A},
+		//            { CMD_SYSCALL, FORMAT_REG_STD },
+		{CMD_XOR, FORMAT_REG_STD},
+
+		{CMD_BGEZ, FORMAT_REGOFF_S},
+		{CMD_BGEZAL, FORMAT_REGOFF_S},
+		{CMD_BGEZALL, FORMAT_REGOFF_S},
+		{CMD_BGEZL, FORMAT_REGOFF_S},
+		{CMD_BLTZ, FORMAT_REGOFF_S},
+		{CMD_BLTZAL, FORMAT_REGOFF_S},
+		{CMD_BLTZALL, FORMAT_REGOFF_S},
+		{CMD_BLTZL, FORMAT_REGOFF_S},
+
+		{CMD_MTC0, FORMAT_REG_COP0},
+		{CMD_MFC0, FORMAT_REG_COP0},
+
+		{CMD_CACHE, FORMAT_REGOFF_CACHE},
+	});
+
+constexpr Format ToFormat(Cmd cmd)
+{
+	uint32_t index = static_cast<uint32_t>(cmd);
+	return index < CmdCount ? gCmdFormats[index] : FORMAT_INVALID;
+}
+
+// Encodes 'inst'. Fields the format of its command has but 'inst' leaves
+// empty are zero in the result and set in 'wildcards'. Throws for commands
+// without an encoding, which fails the build in constant expressions.
+constexpr uint32_t Encode(const Instruction &inst, uint32_t &wildcards)
+{
+	wildcards = 0;
+	if (inst.cmd == CMD_NOP)
+		return 0;
+
+	Format format = ToFormat(inst.cmd);
+	if (format == FORMAT_INVALID)
+		throw std::logic_error("invalid cmd");
+
+	uint32_t ret = 0;
+	auto field = [&](Format part, bool set, uint32_t bits, uint32_t mask) {
+		if (!(static_cast<int>(format) & static_cast<int>(part)))
+			return;
+		if (set)
+			ret |= bits & mask;
+		else
+			wildcards |= mask;
+	};
+
+	field(FORMAT_IMM, inst.imm.has_value(),
+	      static_cast<uint16_t>(inst.imm.value_or(0)), 0x0000ffff);
+	field(FORMAT_OFF, inst.off.has_value(),
+	      static_cast<uint16_t>(inst.off.value_or(0) >> 2), 0x0000ffff);
+	field(FORMAT_JUMP, inst.jump.has_value(), inst.jump.value_or(0) >> 2,
+	      0x03ffffff);
+	field(FORMAT_REG_S, inst.rs.has_value(),
+	      static_cast<uint32_t>(inst.rs.value_or(REG_R0)) << 21,
+	      0x03e00000);
+	field(FORMAT_REG_T, inst.rt.has_value(),
+	      static_cast<uint32_t>(inst.rt.value_or(REG_R0)) << 16,
+	      0x001f0000);
+	field(FORMAT_REG_D, inst.rd.has_value(),
+	      static_cast<uint32_t>(inst.rd.value_or(REG_R0)) << 11,
+	      0x0000f800);
+	field(FORMAT_REG_A, inst.shift.has_value(),
+	      static_cast<uint32_t>(inst.shift.value_or(0)) << 6, 0x000007c0);
+	field(FORMAT_COP0_D, inst.cop0.has_value(),
+	      static_cast<uint32_t>(inst.cop0.value_or(COP0_CONTEXT0)) << 11,
+	      0x0000f800);
+	field(FORMAT_CACHE_T, inst.cache.has_value(),
+	      static_cast<uint32_t>(inst.cache.value_or(CACHE_IIndexInvalidate))
+		      << 16,
+	      0x001f0000);
+
+	Cmd cmd = inst.cmd;
+	uint32_t cmdVal = static_cast<uint32_t>(cmd) & 0b111111;
+	if ((cmd & CMD_REGIMM) == CMD_REGIMM) {
+		uint32_t regimm = 0b000001;
+		ret |= regimm << 26;
+		ret |= cmdVal << 16;
+	} else if (cmd & CMD_REG) {
+		ret |= cmdVal;
+	} else if (cmd & CMD_IMM) {
+		ret |= cmdVal << 26;
+	} else if (cmd & CMD_COP0) {
+		uint32_t cop0 = 0b010000;
+		ret |= cop0 << 26;
+		ret |= cmdVal << 21;
+	} else {
+		throw std::runtime_error("Bad Cmd passed!");
+	}
+
+	return ret;
+}
+
+// Encodes 'inst', fields it leaves empty are zero
+constexpr uint32_t ToUInt(const Instruction &inst)
+{
+	uint32_t wildcards = 0;
+	return Encode(inst, wildcards);
+}
 
-static uint32_t Extract(uint32_t inst, int off, int bits)
+inline uint32_t Extract(uint32_t inst, int off, int bits)
 {
 	uint32_t data = inst >> off;
 	uint32_t mask = 1U << bits;
 	return data & (mask - 1);
 }
 
-static int ExtendZero(int16_t val)
+inline int ExtendZero(int16_t val)
 {
 	uint16_t uval = static_cast<uint16_t>(val);
 	return static_cast<int>(uval);
 }
 
-static int ExtendSign(int16_t val)
+inline int ExtendSign(int16_t val)
 {
 	return static_cast<int>(val);
 }
@@ -0,0 +1,591 @@
+#include "mips_dataflow.h"
+#include "mips_converter.h"
+#include "mips_decompiler.h"
+#include "mips_instruction.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+namespace MIPS {
+enum ValueKind {
+	VALUE_UNKNOWN,
+	VALUE_CONSTANT,
+	// SP at the first propagated instruction plus 'value'
+	VALUE_STACK,
+};
+
+struct AbstractValue {
+	ValueKind kind;
+	Confidence confidence;
+	uint32_t value;
+};
+
+static const AbstractValue Unknown = {VALUE_UNKNOWN, CONFIDENCE_EXACT, 0};
+
+// A word stored to a known address that was not overwritten since
+struct MemoryCell {
+	AbstractValue address;
+	AbstractValue content;
+};
+
+// Enough for the few stores that set up arguments, the oldest ones are
+// forgotten first
+static const int MaxCells = 8;
+
+struct FlowState {
+	AbstractValue regs[32];
+	MemoryCell cells[MaxCells];
+	int cellCount;
+};
+
+// Flows waiting for their forward branch target
+static const int MaxPendingJoins = 4;
+
+struct PendingJoin {
+	int target;
+	FlowState state;
+};
+
+static AbstractValue Constant(uint32_t value, Confidence confidence)
+{
+	return AbstractValue{VALUE_CONSTANT, confidence, value};
+}
+
+static Confidence Weaker(Confidence a, Confidence b)
+{
+	return std::max(a, b);
+}
+
+static bool SameValue(const AbstractValue &a, const AbstractValue &b)
+{
+	return a.kind == b.kind &&
+	       (a.kind == VALUE_UNKNOWN || a.value == b.value);
+}
+
+// Binary operation over two constants, unknown otherwise
+static AbstractValue Fold(const AbstractValue &a, const AbstractValue &b,
+			  uint32_t (*op)(uint32_t, uint32_t))
+{
+	if (a.kind != VALUE_CONSTANT || b.kind != VALUE_CONSTANT)
+		return Unknown;
+
+	return Constant(op(a.value, b.value),
+			Weaker(a.confidence, b.confidence));
+}
+
+// Adds a constant to a constant or a stack address
+static AbstractValue Offset(const AbstractValue &base, uint32_t off,
+			    Confidence confidence = CONFIDENCE_EXACT)
+{
+	if (base.kind == VALUE_UNKNOWN)
+		return Unknown;
+
+	return AbstractValue{base.kind, Weaker(base.confidence, confidence),
+			     base.value + off};
+}
+
+static AbstractValue Add(const AbstractValue &a, const AbstractValue &b)
+{
+	if (b.kind == VALUE_CONSTANT)
+		return Offset(a, b.value, b.confidence);
+	if (a.kind == VALUE_CONSTANT)
+		return Offset(b, a.value, a.confidence);
+
+	return Unknown;
+}
+
+// Cells at the word holding 'address', all of them for unknown addresses
+static void Forget(FlowState &state, const AbstractValue &address)
+{
+	int kept = 0;
+	for (int i = 0; i < state.cellCount; i++) {
+		const AbstractValue &cell = state.cells[i].address;
+		if (address.kind != VALUE_UNKNOWN &&
+		    (cell.kind != address.kind ||
+		     (cell.value & ~3U) != (address.value & ~3U)))
+			state.cells[kept++] = state.cells[i];
+	}
+	state.cellCount = kept;
+}
+
+static void Store(FlowState &state, const AbstractValue &address,
+		  const AbstractValue &content)
+{
+	Forget(state, address);
+	if (address.kind == VALUE_UNKNOWN)
+		return;
+
+	if (state.cellCount == MaxCells) {
+		std::copy(state.cells + 1, state.cells + MaxCells, state.cells);
+		state.cellCount--;
+	}
+	state.cells[state.cellCount++] = MemoryCell{address, content};
+}
+
+static AbstractValue Load(const FlowState &state, const AbstractValue &address)
+{
+	if (address.kind == VALUE_UNKNOWN)
+		return Unknown;
+
+	for (int i = 0; i < state.cellCount; i++) {
+		const MemoryCell &cell = state.cells[i];
+		if (SameValue(cell.address, address))
+			return Offset(cell.content, 0, address.confidence);
+	}
+
+	return Unknown;
+}
+
+// Keeps what both flows agree on, with the weaker confidence
+static void Join(FlowState &state, const FlowState &other)
+{
+	for (int r = 0; r < 32; r++) {
+		AbstractValue &value = state.regs[r];
+		if (!SameValue(value, other.regs[r]))
+			value = Unknown;
+		value.confidence =
+			Weaker(value.confidence, other.regs[r].confidence);
+	}
+
+	int kept = 0;
+	for (int i = 0; i < state.cellCount; i++) {
+		const MemoryCell &cell = state.cells[i];
+		for (int j = 0; j < other.cellCount; j++) {
+			const MemoryCell &theirs = other.cells[j];
+			if (!SameValue(cell.address, theirs.address) ||
+			    !SameValue(cell.content, theirs.content))
+				continue;
+
+			MemoryCell &joined = state.cells[kept++];
+			joined = cell;
+			joined.content.confidence = Weaker(
+				cell.content.confidence,
+				theirs.content.confidence);
+			break;
+		}
+	}
+	state.cellCount = kept;
+}
+
+// The callee may change the caller saved registers and anything but the
+// caller's stack frame
+static void Clobber(FlowState &state)
+{
+	static const Register CallerSaved[] = {
+		REG_AT, REG_V0, REG_V1, REG_A0, REG_A1, REG_A2, REG_A3,
+		REG_T0, REG_T1, REG_T2, REG_T3, REG_T4, REG_T5, REG_T6,
+		REG_T7, REG_T8, REG_T9, REG_RA,
+	};
+	for (Register r : CallerSaved)
+		state.regs[r] = Unknown;
+
+	int kept = 0;
+	for (int i = 0; i < state.cellCount; i++)
+		if (state.cells[i].address.kind == VALUE_STACK)
+			state.cells[kept++] = state.cells[i];
+	state.cellCount = kept;
+}
+
+static bool IsCall(Cmd cmd)
+{
+	switch (cmd) {
+	case CMD_JAL:
+	case CMD_JALR:
+	case CMD_BGEZAL:
+	case CMD_BGEZALL:
+	case CMD_BLTZAL:
+	case CMD_BLTZALL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool IsLikely(Cmd cmd)
+{
+	switch (cmd) {
+	case CMD_BEQL:
+	case CMD_BNEL:
+	case CMD_BGTZL:
+	case CMD_BLEZL:
+	case CMD_BGEZL:
+	case CMD_BLTZL:
+	case CMD_BGEZALL:
+	case CMD_BLTZALL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool IsBranch(Cmd cmd)
+{
+	switch (cmd) {
+	case CMD_BEQ:
+	case CMD_BNE:
+	case CMD_BGTZ:
+	case CMD_BLEZ:
+	case CMD_BGEZ:
+	case CMD_BLTZ:
+		return true;
+	default:
+		return IsLikely(cmd);
+	}
+}
+
+// Control never falls through to the instruction after the delay slot
+static bool IsJump(const PackedInstruction &inst)
+{
+	switch (inst.cmd()) {
+	case CMD_J:
+	case CMD_JR:
+		return true;
+	case CMD_BEQ:
+		return inst.rs() == REG_R0 && inst.rt() == REG_R0;
+	default:
+		return false;
+	}
+}
+
+// Register that an instruction without modelled semantics may change
+static int WrittenRegister(const PackedInstruction &inst)
+{
+	switch (inst.cmd()) {
+	case CMD_LB:
+	case CMD_LBU:
+	case CMD_LD:
+	case CMD_LDL:
+	case CMD_LDR:
+	case CMD_LH:
+	case CMD_LHU:
+	case CMD_LL:
+	case CMD_LLD:
+	case CMD_LW:
+	case CMD_LWL:
+	case CMD_LWR:
+	case CMD_LWU:
+	case CMD_SC:
+	case CMD_SCD:
+	case CMD_MFC0:
+		return inst.rt();
+	default:
+		break;
+	}
+
+	Format format = gCmdFormats[inst.cmd()];
+	if (format & FORMAT_REG_D)
+		return inst.rd();
+	if ((format & FORMAT_IMM) && (format & FORMAT_REG_T))
+		return inst.rt();
+
+	return -1;
+}
+
+// Stores of known words are appended to 'stored' with at least 'confidence'
+static void Execute(FlowState &state, const PackedInstruction &inst,
+		    Confidence confidence, std::vector<KnownValue> &stored)
+{
+	const AbstractValue &s = state.regs[inst.rs()];
+	const AbstractValue &t = state.regs[inst.rt()];
+	uint32_t imm = static_cast<uint32_t>(static_cast<int32_t>(inst.imm()));
+	uint32_t zimm = imm & 0xFFFF;
+	// Loads and stores are not shifted, unlike the decoded offset
+	AbstractValue address =
+		Offset(s, static_cast<uint32_t>(inst.off() / 4));
+	AbstractValue shamt = Constant(static_cast<uint32_t>(inst.shift()),
+				       CONFIDENCE_EXACT);
+	AbstractValue immediate = Constant(imm, CONFIDENCE_EXACT);
+	AbstractValue zeroExtended = Constant(zimm, CONFIDENCE_EXACT);
+
+	int dst = -1;
+	AbstractValue result = Unknown;
+	switch (inst.cmd()) {
+	case CMD_LUI:
+		dst = inst.rt();
+		result = Constant(zimm << 16, CONFIDENCE_EXACT);
+		break;
+	case CMD_ADDI:
+	case CMD_ADDIU:
+	case CMD_DADDI:
+	case CMD_DADDIU:
+		dst = inst.rt();
+		result = Offset(s, imm);
+		break;
+	case CMD_ORI:
+		dst = inst.rt();
+		result = Fold(s, zeroExtended,
+			      [](uint32_t a, uint32_t b) { return a | b; });
+		break;
+	case CMD_ANDI:
+		dst = inst.rt();
+		result = Fold(s, zeroExtended,
+			      [](uint32_t a, uint32_t b) { return a & b; });
+		break;
+	case CMD_XORI:
+		dst = inst.rt();
+		result = Fold(s, zeroExtended,
+			      [](uint32_t a, uint32_t b) { return a ^ b; });
+		break;
+	case CMD_SLTI:
+		dst = inst.rt();
+		result = Fold(s, immediate, [](uint32_t a, uint32_t b) {
+			return static_cast<uint32_t>(static_cast<int32_t>(a) <
+						     static_cast<int32_t>(b));
+		});
+		break;
+	case CMD_SLTIU:
+		dst = inst.rt();
+		result = Fold(s, immediate, [](uint32_t a, uint32_t b) {
+			return static_cast<uint32_t>(a < b);
+		});
+		break;
+	case CMD_ADD:
+	case CMD_ADDU:
+	case CMD_DADD:
+	case CMD_DADDU:
+		dst = inst.rd();
+		result = Add(s, t);
+		break;
+	case CMD_SUB:
+	case CMD_SUBU:
+	case CMD_DSUB:
+	case CMD_DSUBU:
+		dst = inst.rd();
+		if (t.kind == VALUE_CONSTANT)
+			result = Offset(s, 0U - t.value, t.confidence);
+		break;
+	case CMD_OR:
+		dst = inst.rd();
+		// Also MOVE
+		if (t.kind == VALUE_CONSTANT && t.value == 0)
+			result = Offset(s, 0, t.confidence);
+		else if (s.kind == VALUE_CONSTANT && s.value == 0)
+			result = Offset(t, 0, s.confidence);
+		else
+			result = Fold(s, t, [](uint32_t a, uint32_t b) {
+				return a | b;
+			});
+		break;
+	case CMD_AND:
+		dst = inst.rd();
+		result = Fold(s, t,
+			      [](uint32_t a, uint32_t b) { return a & b; });
+		break;
+	case CMD_XOR:
+		dst = inst.rd();
+		result = Fold(s, t,
+			      [](uint32_t a, uint32_t b) { return a ^ b; });
+		break;
+	case CMD_NOR:
+		dst = inst.rd();
+		result = Fold(s, t,
+			      [](uint32_t a, uint32_t b) { return ~(a | b); });
+		break;
+	case CMD_SLT:
+		dst = inst.rd();
+		result = Fold(s, t, [](uint32_t a, uint32_t b) {
+			return static_cast<uint32_t>(static_cast<int32_t>(a) <
+						     static_cast<int32_t>(b));
+		});
+		break;
+	case CMD_SLTU:
+		dst = inst.rd();
+		result = Fold(s, t, [](uint32_t a, uint32_t b) {
+			return static_cast<uint32_t>(a < b);
+		});
+		break;
+	case CMD_SLL:
+		dst = inst.rd();
+		result = Fold(t, shamt,
+			      [](uint32_t a, uint32_t b) { return a << b; });
+		break;
+	case CMD_SRL:
+		dst = inst.rd();
+		result = Fold(t, shamt,
+			      [](uint32_t a, uint32_t b) { return a >> b; });
+		break;
+	case CMD_SRA:
+		dst = inst.rd();
+		result = Fold(t, shamt, [](uint32_t a, uint32_t b) {
+			return static_cast<uint32_t>(static_cast<int32_t>(a) >>
+						     b);
+		});
+		break;
+	case CMD_SLLV:
+		dst = inst.rd();
+		result = Fold(t, s, [](uint32_t a, uint32_t b) {
+			return a << (b & 0x1F);
+		});
+		break;
+	case CMD_SRLV:
+		dst = inst.rd();
+		result = Fold(t, s, [](uint32_t a, uint32_t b) {
+			return a >> (b & 0x1F);
+		});
+		break;
+	case CMD_SRAV:
+		dst = inst.rd();
+		result = Fold(t, s, [](uint32_t a, uint32_t b) {
+			return static_cast<uint32_t>(static_cast<int32_t>(a) >>
+						     (b & 0x1F));
+		});
+		break;
+	case CMD_LW:
+	case CMD_LWU:
+		dst = inst.rt();
+		result = Load(state, address);
+		break;
+	case CMD_SW:
+		if (t.kind == VALUE_CONSTANT)
+			stored.push_back(KnownValue{
+				t.value, Weaker(t.confidence, confidence)});
+		Store(state, address, t);
+		break;
+	case CMD_SB:
+	case CMD_SH:
+	case CMD_SWL:
+	case CMD_SWR:
+	case CMD_SD:
+	case CMD_SDL:
+	case CMD_SDR:
+	case CMD_SC:
+	case CMD_SCD:
+		dst = WrittenRegister(inst);
+		Forget(state, address);
+		if (inst.cmd() == CMD_SD || inst.cmd() == CMD_SDL ||
+		    inst.cmd() == CMD_SDR || inst.cmd() == CMD_SCD)
+			Forget(state, Offset(address, 4));
+		break;
+	default:
+		dst = WrittenRegister(inst);
+		break;
+	}
+
+	// R0 stays zero
+	if (dst > 0)
+		state.regs[dst] = result;
+}
+
+// First word to propagate from, the JAL itself if nothing before it is usable
+static int FindStart(const std::vector<uint32_t> &mem, int jal, int maxLength)
+{
+	int start = jal;
+	for (int i = jal - 1; i >= 0 && i >= jal - maxLength; i--) {
+		std::optional<PackedInstruction> inst = decodePacked(mem[i]);
+		if (!inst)
+			break;
+
+		// Nothing before a jump and its delay slot flows into the JAL
+		if (IsJump(*inst)) {
+			start = std::min(i + 2, jal);
+			break;
+		}
+		start = i;
+	}
+
+	return start;
+}
+
+void PropagateToCall(const std::vector<uint32_t> &mem, int jal, int maxLength,
+		     std::optional<uint32_t> gp, CallState &call)
+{
+	int start = FindStart(mem, jal, maxLength);
+	// The delay slot of the JAL is the last instruction
+	int end = std::min(jal + 1, static_cast<int>(mem.size()) - 1);
+
+	FlowState state;
+	std::fill(std::begin(state.regs), std::end(state.regs), Unknown);
+	state.regs[REG_R0] = Constant(0, CONFIDENCE_EXACT);
+	state.regs[REG_SP] = AbstractValue{VALUE_STACK, CONFIDENCE_EXACT, 0};
+	if (gp.has_value())
+		state.regs[REG_GP] = Constant(gp.value(), CONFIDENCE_ASSUMED);
+	state.cellCount = 0;
+
+	PendingJoin pending[MaxPendingJoins];
+	int pendingCount = 0;
+	// Weakened for the whole result by flows that are not followed
+	Confidence flow = CONFIDENCE_EXACT;
+	// Stores before this word may be skipped by a forward branch
+	int skippable = start;
+
+	call.stored.clear();
+	for (int i = start; i <= end; i++) {
+		for (int p = 0; p < pendingCount;) {
+			if (pending[p].target != i) {
+				p++;
+				continue;
+			}
+
+			Join(state, pending[p].state);
+			pending[p] = pending[--pendingCount];
+		}
+
+		std::optional<PackedInstruction> inst = decodePacked(mem[i]);
+		// Only the delay slot of the JAL may not be code
+		if (!inst)
+			continue;
+
+		Confidence confidence = i < skippable ? CONFIDENCE_ASSUMED
+						      : CONFIDENCE_EXACT;
+		Cmd cmd = inst->cmd();
+		// Branches with the JAL in their delay slot are taken as is
+		bool hasSlot = i + 1 < jal;
+		if (!hasSlot || (!IsCall(cmd) && !IsBranch(cmd))) {
+			Execute(state, *inst, confidence, call.stored);
+			continue;
+		}
+
+		// Every word between the start and the JAL decodes
+		PackedInstruction slot = *decodePacked(mem[i + 1]);
+		bool likely = IsLikely(cmd);
+		FlowState notTaken;
+		if (likely)
+			notTaken = state;
+		// The slot of a likely branch only runs when it is taken
+		Execute(state, slot, likely ? CONFIDENCE_ASSUMED : confidence,
+			call.stored);
+
+		if (IsCall(cmd)) {
+			// Returns to the word after the delay slot
+			Clobber(state);
+			if (likely)
+				Join(state, notTaken);
+			i++;
+			continue;
+		}
+
+		int target = i + 1 + inst->off() / 4;
+		if (target > i + 1 && target <= jal) {
+			if (pendingCount < MaxPendingJoins)
+				pending[pendingCount++] =
+					PendingJoin{target, state};
+			else
+				flow = CONFIDENCE_ASSUMED;
+			skippable = std::max(skippable, target);
+		} else if (target <= i + 1) {
+			// Loops are only followed once, including those that
+			// start before the window
+			flow = CONFIDENCE_ASSUMED;
+		}
+
+		if (likely)
+			state = notTaken;
+		i++;
+	}
+
+	for (int r = 0; r < 32; r++) {
+		const AbstractValue &value = state.regs[r];
+		if (value.kind == VALUE_CONSTANT)
+			call.regs[r] = KnownValue{
+				value.value, Weaker(value.confidence, flow)};
+		else
+			call.regs[r] = std::nullopt;
+	}
+	for (KnownValue &stored : call.stored)
+		stored.confidence = Weaker(stored.confidence, flow);
+	call.start = start;
+}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "mips_types.h"
+
+#include <stdint.h>
+
+#include <optional>
+#include <vector>
+
+namespace MIPS {
+// How far a recovered value can be trusted, from most to least
+enum Confidence {
+	// Follows from the code leading to the call on every path through it
+	CONFIDENCE_EXACT,
+	// Also depends on an assumption: the GP value given by the caller or
+	// a backward branch into the code that was only followed once
+	CONFIDENCE_ASSUMED,
+	// Came from running the code from zeroed registers instead
+	CONFIDENCE_GUESSED,
+};
+
+struct KnownValue {
+	uint32_t value;
+	Confidence confidence;
+};
+
+// Registers at a JAL and the words stored on the way there, as far as
+// constant propagation over the code leading to it can tell
+struct CallState {
+	// Nothing for registers that do not hold a known constant
+	std::optional<KnownValue> regs[32];
+	// Known words stored by SW in program order, stores that a branch
+	// may skip are CONFIDENCE_ASSUMED. Cleared but not freed by every run.
+	std::vector<KnownValue> stored;
+	// First instruction that was propagated through
+	int start;
+};
+
+// Propagates known constants, stack and GP relative addresses and the words
+// stored to them forward to the JAL at word 'jal', including its delay slot.
+// Starts at most 'maxLength' words before the JAL, after the closest jump,
+// JR or word that is not code. Forward branches in between are joined at
+// their targets and earlier calls clobber the registers they may change.
+// Registers start unknown except for R0 and GP if 'gp' is given. Loads,
+// stores and ORI/ANDI/XORI follow the architecture, not 'Interpreter'.
+void PropagateToCall(const std::vector<uint32_t> &mem, int jal, int maxLength,
+		     std::optional<uint32_t> gp, CallState &state);
+}
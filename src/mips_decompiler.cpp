@@ -1,79 +1,75 @@
 #include "mips_decompiler.h"
 #include "mips_converter.h"
 
-#include <stdexcept>
+#include <array>
 
 namespace MIPS {
-Instruction decodeInstruction(uint32_t inst)
+// Where the rest of the Cmd is for every primary opcode: SPECIAL, REGIMM and
+// COP0 keep it in another field, other opcodes are the Cmd on their own
+struct OpDecode {
+	uint16_t cmd;
+	uint8_t shift;
+	uint8_t mask;
+};
+
+static constexpr std::array<OpDecode, 64> MakeOpDecodeTable()
 {
-	Instruction ret;
-
-	if (inst == 0) {
-		ret.cmd = CMD_NOP;
-		return ret;
-	}
-
-	Op op = static_cast<Op>((inst >> 26) & 0x3F);
-
-	if (op == OP_SPECIAL) {
-		Funct funct = static_cast<Funct>(inst & 0x3F);
-		ret.cmd = ToCmd(funct);
-	} else if (op == OP_REGIMM) {
-		FunctImm functImm = static_cast<FunctImm>((inst >> 16) & 0x1F);
-		ret.cmd = ToCmd(functImm);
-	} else if (op == OP_COP0) {
-		Cop cop = static_cast<Cop>((inst >> 21) & 0x1F);
-
-		if (cop != COP_MF && cop != COP_MT) {
-			throw std::invalid_argument("Unknown COP instruction");
-		}
-
-		ret.cmd = ToCmd(cop, 0);
-	} else if (op == OP_COP1) {
-		throw std::invalid_argument("CoProcessor 1 is not supported");
-	} else {
-		ret.cmd = ToCmd(op);
-	}
-
-	Format format = ToFormat(ret.cmd);
-
-	if (format & FORMAT_IMM) {
-		ret.imm = static_cast<short>(inst & 0xFFFF);
-	}
-
-	if (format & FORMAT_OFF) {
-		short off = static_cast<short>(inst & 0xFFFF);
-		ret.off = (ExtendSign(off) << 2);
-	}
-
-	if (format & FORMAT_JUMP) {
-		ret.jump = inst & 0x3FFFFFF;
-	}
-
-	if (format & FORMAT_REG_S) {
-		ret.rs = static_cast<Register>((inst >> 21) & 0x1F);
-	}
+	std::array<OpDecode, 64> table{};
+	for (uint16_t op = 0; op < 64; op++)
+		table[op] = {static_cast<uint16_t>(CMD_IMM | op), 0, 0};
+
+	table[OP_SPECIAL] = {CMD_REG, 0, 0x3F};
+	table[OP_REGIMM] = {CMD_REGIMM, 16, 0x1F};
+	table[OP_COP0] = {CMD_COP0, 21, 0x1F};
+	return table;
+}
 
-	if (format & FORMAT_REG_T) {
-		ret.rt = static_cast<Register>((inst >> 16) & 0x1F);
-	}
+static constexpr std::array<OpDecode, 64> sOpDecode = MakeOpDecodeTable();
 
-	if (format & FORMAT_REG_D) {
-		ret.rd = static_cast<Register>((inst >> 11) & 0x1F);
-	}
+std::optional<PackedInstruction> decodePacked(uint32_t inst)
+{
+	if (inst == 0)
+		return PackedInstruction{CMD_NOP, 0};
+
+	const OpDecode &op = sOpDecode[inst >> 26];
+	uint32_t cmd = op.cmd | ((inst >> op.shift) & op.mask);
+	Format format = gCmdFormats[cmd];
+	if (format == FORMAT_INVALID)
+		return std::nullopt;
+
+	// Register fields are taken as is, the format tells which are real
+	PackedInstruction ret;
+	ret.fields = cmd |
+		     (((inst >> 21) & 0x1F) << PackedInstruction::RsShift) |
+		     (((inst >> 16) & 0x1F) << PackedInstruction::RtShift) |
+		     (((inst >> 11) & 0x1F) << PackedInstruction::RdShift) |
+		     (((inst >> 6) & 0x1F) << PackedInstruction::ShiftShift);
+
+	short imm = static_cast<short>(inst & 0xFFFF);
+	if (format & FORMAT_JUMP)
+		ret.value = static_cast<int32_t>(inst & 0x3FFFFFF);
+	else if (format & FORMAT_OFF)
+		ret.value = ExtendSign(imm) * 4;
+	else
+		ret.value = imm;
 
-	if (format & FORMAT_REG_A) {
-		ret.shift = static_cast<uint16_t>((inst >> 6) & 0x1F);
-	}
+	return ret;
+}
 
-	if (format & FORMAT_COP0_D) {
-		ret.cop0 = static_cast<Cop0Registers>((inst >> 11) & 0x1F);
-	}
+std::optional<Instruction> decodeInstruction(uint32_t inst)
+{
+	std::optional<PackedInstruction> packed = decodePacked(inst);
+	if (!packed)
+		return std::nullopt;
 
-	if (format & FORMAT_CACHE_T) {
-		ret.cache = static_cast<CacheOp>((inst >> 16) & 0x1F);
-	}
+	return packed->view();
+}
 
-	return ret;
+uint32_t decodeCmd(uint32_t inst)
+{
+	const OpDecode &op = sOpDecode[inst >> 26];
+	uint32_t cmd = op.cmd | ((inst >> op.shift) & op.mask);
+	cmd = inst == 0 ? static_cast<uint32_t>(CMD_NOP) : cmd;
+	return gCmdFormats[cmd] == FORMAT_INVALID ? CmdCount : cmd;
+}
 }
-}
\ No newline at end of file
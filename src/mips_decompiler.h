@@ -4,6 +4,13 @@
 
 #include <stdint.h>
 
+#include <optional>
+
 namespace MIPS {
-Instruction decodeInstruction(uint32_t inst);
+// Both return nothing for encodings the decoder does not support
+std::optional<PackedInstruction> decodePacked(uint32_t inst);
+std::optional<Instruction> decodeInstruction(uint32_t inst);
+// Only the Cmd of 'decodePacked', CmdCount for unsupported encodings. Has no
+// data dependent branches for sweeping over whole RAM.
+uint32_t decodeCmd(uint32_t inst);
 }
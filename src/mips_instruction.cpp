@@ -1,4 +1,5 @@
 #include "mips_instruction.h"
+#include "mips_converter.h"
 
 #include <iomanip>
 #include <sstream>
@@ -73,4 +74,34 @@ std::string Instruction::toString()
 
 	return output;
 }
+
+Instruction PackedInstruction::view() const
+{
+	Instruction ret;
+	ret.cmd = cmd();
+	if (ret.cmd == CMD_NOP)
+		return ret;
+
+	Format format = ToFormat(ret.cmd);
+	if (format & FORMAT_IMM)
+		ret.imm = imm();
+	if (format & FORMAT_OFF)
+		ret.off = off();
+	if (format & FORMAT_JUMP)
+		ret.jump = jump();
+	if (format & FORMAT_REG_S)
+		ret.rs = rs();
+	if (format & FORMAT_REG_T)
+		ret.rt = rt();
+	if (format & FORMAT_REG_D)
+		ret.rd = rd();
+	if (format & FORMAT_REG_A)
+		ret.shift = shift();
+	if (format & FORMAT_COP0_D)
+		ret.cop0 = cop0();
+	if (format & FORMAT_CACHE_T)
+		ret.cache = cache();
+
+	return ret;
+}
 }
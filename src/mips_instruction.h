@@ -6,7 +6,7 @@
 
 namespace MIPS {
 struct Instruction {
-	Cmd cmd;
+	Cmd cmd = CMD_NOP;
 	std::optional<Register> rs;
 	std::optional<Register> rt;
 	std::optional<Register> rd;
@@ -19,4 +19,41 @@ struct Instruction {
 
 	std::string toString();
 };
+
+// Decoded instruction in 8 bytes for the analysis loops. Which fields mean
+// anything is decided by the format of 'cmd()'. COP0 registers share the 'rd'
+// bits and cache ops the 'rt' bits as they do in the encoding, 'value' is the
+// immediate, the offset or the jump target.
+struct PackedInstruction {
+	static const int RsShift = 10;
+	static const int RtShift = 15;
+	static const int RdShift = 20;
+	static const int ShiftShift = 25;
+
+	uint32_t fields;
+	int32_t value;
+
+	Cmd cmd() const { return static_cast<Cmd>(fields & 0x3FF); }
+	Register rs() const { return field<Register>(RsShift); }
+	Register rt() const { return field<Register>(RtShift); }
+	Register rd() const { return field<Register>(RdShift); }
+	int shift() const { return field<int>(ShiftShift); }
+	Cop0Registers cop0() const { return field<Cop0Registers>(RdShift); }
+	CacheOp cache() const { return field<CacheOp>(RtShift); }
+	short imm() const { return static_cast<short>(value); }
+	int off() const { return value; }
+	uint32_t jump() const { return static_cast<uint32_t>(value); }
+
+	// Same instruction in the form 'ToUInt' and 'toString' work with
+	Instruction view() const;
+
+private:
+	template<typename T> T field(int at) const
+	{
+		return static_cast<T>((fields >> at) & 0x1F);
+	}
+};
+
+static_assert(sizeof(PackedInstruction) == 8,
+	      "PackedInstruction is meant to fit in a register");
 }
@@ -1,457 +1,1097 @@
 #include "mips_interpreter.h"
 
+#include "mips_converter.h"
 #include "mips_decompiler.h"
 
+#include <algorithm>
+#include <iterator>
+
 namespace MIPS {
-void Interpreter::Add(const Instruction &inst)
+Interpreter::Interpreter(const std::vector<uint32_t> &ram)
+	: memory(ram), decodeCache_(DecodeCacheSize)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = rs + rt;
-	}
+	for (uint32_t i = 0; i < DecodeCacheSize; i++)
+		decodeCache_[i].pc = (i ^ 1) << 2;
 }
 
-void Interpreter::AddI(const Instruction &inst)
+bool Interpreter::load(int32_t vAddr, uint32_t &value)
 {
-	if (inst.rs && inst.rt && inst.imm) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t imm = static_cast<int>(*inst.imm);
-		int32_t rt = static_cast<int>(*inst.rt);
-		gpr[rt] = rs + imm;
-	}
+	if (memory.read(static_cast<uint32_t>(vAddr), value))
+		return true;
+
+	faults |= FAULT_LOAD;
+	return false;
 }
 
-void Interpreter::And(const Instruction &inst)
+void Interpreter::Add(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = rs & rt;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = rs + rt;
 }
 
-void Interpreter::AndI(const Instruction &inst)
+void Interpreter::AddI(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.imm) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t imm = static_cast<int>(*inst.imm);
-		int32_t rt = static_cast<int>(*inst.rt);
-		gpr[rt] = rs & imm;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t imm = static_cast<int>(inst.imm());
+	int32_t rt = static_cast<int>(inst.rt());
+	gpr[rt] = rs + imm;
 }
 
-void Interpreter::Div(const Instruction &inst)
+void Interpreter::And(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		if (0 == rt)
-			throw std::logic_error("Bad div");
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = rs & rt;
+}
 
-		lo = rs % rt;
-		hi = rs / rt;
-	}
+void Interpreter::AndI(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t imm = static_cast<int>(inst.imm());
+	int32_t rt = static_cast<int>(inst.rt());
+	gpr[rt] = rs & imm;
 }
 
-void Interpreter::DivU(const Instruction &inst)
+void Interpreter::branch(bool taken, bool likely, uint32_t target)
 {
-	if (inst.rs && inst.rt) {
-		uint32_t rsv =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rs)]);
-		uint32_t rtv =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rt)]);
-		if (0 == rtv)
-			throw std::logic_error("Bad div");
+	if (stopPc_ && pc <= *stopPc_ && target > *stopPc_)
+		taken = false;
 
-		lo = rsv % rtv;
-		hi = rsv / rtv;
+	if (!taken) {
+		if (likely)
+			pc += 4;
+		return;
 	}
+
+	const uint32_t *visited = visited_;
+	const uint32_t *visitedEnd = visited + visitedCount_;
+	if (visitedCount_ == MaxVisitedBlocks ||
+	    std::find(visited, visitedEnd, target) != visitedEnd) {
+		faults |= FAULT_LOOP;
+		return;
+	}
+
+	visited_[visitedCount_++] = target;
+	delayed_ = true;
+	delayedPc_ = target;
 }
 
-void Interpreter::LB(const Instruction &inst)
+void Interpreter::link(bool taken, bool likely)
 {
-	if (inst.rs && inst.rt && inst.off) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t off = static_cast<int>(*inst.off);
-		int32_t vAddr = off + rs;
-		int32_t dataPos = vAddr & 0x3;
-		uint32_t pAddr = memory.read(vAddr);
-		gpr[static_cast<int>(*inst.rt)] =
-			static_cast<int8_t>(pAddr >> (24 - dataPos * 8));
-	}
+	if (taken)
+		gpr[static_cast<int>(REG_RA)] = static_cast<int32_t>(pc + 4);
+	else if (likely)
+		pc += 4;
 }
 
-void Interpreter::LBU(const Instruction &inst)
+void Interpreter::BEQ(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.off) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t off = static_cast<int>(*inst.off);
-		int32_t vAddr = off + rs;
-		int32_t dataPos = vAddr & 0x3;
-		uint32_t pAddr = memory.read(vAddr);
-		gpr[static_cast<int>(*inst.rt)] =
-			static_cast<uint8_t>(pAddr >> (24 - dataPos * 8));
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	branch(rs == rt, false, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::LH(const Instruction &inst)
+void Interpreter::BEQL(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.off) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t off = static_cast<int>(*inst.off);
-		int32_t vAddr = off + rs;
-		int32_t shortPos = vAddr & 0x1;
-		uint32_t pAddr = memory.read(vAddr);
-		gpr[static_cast<int>(*inst.rt)] =
-			static_cast<int16_t>(pAddr >> (16 - shortPos * 16));
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	branch(rs == rt, true, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::LHU(const Instruction &inst)
+void Interpreter::BGEZ(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.off) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t off = static_cast<int>(*inst.off);
-		int32_t vAddr = off + rs;
-		int32_t shortPos = vAddr & 0x1;
-		uint32_t pAddr = memory.read(vAddr);
-		gpr[static_cast<int>(*inst.rt)] =
-			static_cast<uint16_t>(pAddr >> (16 - shortPos * 16));
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	branch(rs >= 0, false, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::LUI(const Instruction &inst)
+void Interpreter::BGEZAL(const PackedInstruction &inst)
 {
-	if (inst.rt && inst.imm) {
-		int32_t imm = static_cast<int>(*inst.imm);
-		gpr[static_cast<int>(*inst.rt)] = imm << 16;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	link(rs >= 0, false);
 }
 
-void Interpreter::LW(const Instruction &inst)
+void Interpreter::BGEZALL(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.off) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t off = static_cast<int>(*inst.off);
-		int32_t vAddr = off + rs;
-		gpr[static_cast<int>(*inst.rt)] = memory.read(vAddr);
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	link(rs >= 0, true);
 }
 
-void Interpreter::MFHI(const Instruction &inst)
+void Interpreter::BGEZL(const PackedInstruction &inst)
 {
-	if (inst.rd) {
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = hi;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	branch(rs >= 0, true, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::MFLO(const Instruction &inst)
+void Interpreter::BGTZ(const PackedInstruction &inst)
 {
-	if (inst.rd) {
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = lo;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	branch(rs > 0, false, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::MTHI(const Instruction &inst)
+void Interpreter::BGTZL(const PackedInstruction &inst)
 {
-	if (inst.rs) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		hi = rs;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	branch(rs > 0, true, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::MTLO(const Instruction &inst)
+void Interpreter::BLEZ(const PackedInstruction &inst)
 {
-	if (inst.rs) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		lo = rs;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	branch(rs <= 0, false, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::Mult(const Instruction &inst)
+void Interpreter::BLEZL(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int64_t val =
-			static_cast<int64_t>(rs) * static_cast<int64_t>(rt);
-		lo = static_cast<int32_t>(val);
-		hi = static_cast<int32_t>(val >> 32);
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	branch(rs <= 0, true, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::MultU(const Instruction &inst)
+void Interpreter::BLTZ(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt) {
-		uint32_t rs =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rs)]);
-		uint32_t rt =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rt)]);
-		uint64_t val =
-			static_cast<uint64_t>(rs) * static_cast<uint64_t>(rt);
-		lo = static_cast<int32_t>(val);
-		hi = static_cast<int32_t>(val >> 32);
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	branch(rs < 0, false, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::NOr(const Instruction &inst)
+void Interpreter::BLTZAL(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = ~(rs | rt);
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	link(rs < 0, false);
 }
 
-void Interpreter::Or(const Instruction &inst)
+void Interpreter::BLTZALL(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = rs | rt;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	link(rs < 0, true);
 }
 
-void Interpreter::OrI(const Instruction &inst)
+void Interpreter::BLTZL(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.imm) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t imm = static_cast<int>(*inst.imm);
-		int32_t rt = static_cast<int>(*inst.rt);
-		gpr[rt] = rs | imm;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	branch(rs < 0, true, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::SB(const Instruction &inst)
+void Interpreter::BNE(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.off) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t off = static_cast<int>(*inst.off);
-		int32_t vAddr = off + rs;
-		int32_t dataPos = vAddr & 0x3;
-		memory.write(vAddr, static_cast<uint8_t>(rt), dataPos);
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	branch(rs != rt, false, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::SH(const Instruction &inst)
+void Interpreter::BNEL(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.off) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t off = static_cast<int>(*inst.off);
-		int32_t vAddr = off + rs;
-		int32_t shortPos = vAddr & 0x1;
-		memory.write(vAddr, static_cast<uint16_t>(rt), shortPos);
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	branch(rs != rt, true, pc + static_cast<uint32_t>(inst.off()));
 }
 
-void Interpreter::SLL(const Instruction &inst)
+void Interpreter::Div(const PackedInstruction &inst)
 {
-	if (inst.rt && inst.rd && inst.shift) {
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		int32_t sa = static_cast<int>(*inst.shift);
-		gpr[rd] = rt << sa;
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	if (0 == rt) {
+		faults |= FAULT_DIVIDE_BY_ZERO;
+		return;
 	}
+
+	// 64-bit so INT32_MIN / -1 does not trap the host
+	lo = static_cast<int32_t>(static_cast<int64_t>(rs) % rt);
+	hi = static_cast<int32_t>(static_cast<int64_t>(rs) / rt);
 }
 
-void Interpreter::SLLV(const Instruction &inst)
+void Interpreter::DivU(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = rt << rs;
+	uint32_t rsv = static_cast<uint32_t>(gpr[static_cast<int>(inst.rs())]);
+	uint32_t rtv = static_cast<uint32_t>(gpr[static_cast<int>(inst.rt())]);
+	if (0 == rtv) {
+		faults |= FAULT_DIVIDE_BY_ZERO;
+		return;
 	}
+
+	lo = rsv % rtv;
+	hi = rsv / rtv;
 }
 
-void Interpreter::SLT(const Instruction &inst)
+void Interpreter::J(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = (rs < rt) ? 1 : 0;
-	}
+	branch(true, false, (pc & 0xF0000000) | (inst.jump() << 2));
 }
 
-void Interpreter::SLTI(const Instruction &inst)
+void Interpreter::JAL(const PackedInstruction &)
 {
-	if (inst.rs && inst.rt && inst.imm) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t imm = static_cast<int>(*inst.imm);
-		int32_t rt = static_cast<int>(*inst.rt);
-		gpr[rt] = (rs < imm) ? 1 : 0;
-	}
+	gpr[static_cast<int>(REG_RA)] = static_cast<int32_t>(pc + 4);
 }
 
-void Interpreter::SLTIU(const Instruction &inst)
+void Interpreter::JALR(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.imm) {
-		uint32_t rs =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rs)]);
-		uint32_t imm = static_cast<uint32_t>(*inst.imm);
-		int32_t rt = static_cast<int>(*inst.rt);
-		gpr[rt] = (rs < imm) ? 1 : 0;
-	}
+	gpr[static_cast<int>(inst.rd())] = static_cast<int32_t>(pc + 4);
 }
 
-void Interpreter::SLTU(const Instruction &inst)
+void Interpreter::JR(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		uint32_t rs =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rs)]);
-		uint32_t rt =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rt)]);
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = (rs < rt) ? 1 : 0;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	branch(true, false, static_cast<uint32_t>(rs));
 }
 
-void Interpreter::SRA(const Instruction &inst)
+void Interpreter::LB(const PackedInstruction &inst)
 {
-	if (inst.rt && inst.rd && inst.shift) {
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		int32_t sa = static_cast<int>(*inst.shift);
-		gpr[rd] = rt >> sa;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t off = static_cast<int>(inst.off());
+	int32_t vAddr = off + rs;
+	int32_t dataPos = vAddr & 0x3;
+	uint32_t pAddr;
+	if (!load(vAddr, pAddr))
+		return;
+
+	gpr[static_cast<int>(inst.rt())] =
+		static_cast<int8_t>(pAddr >> (24 - dataPos * 8));
 }
 
-void Interpreter::SRAV(const Instruction &inst)
+void Interpreter::LBU(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = rt >> rs;
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t off = static_cast<int>(inst.off());
+	int32_t vAddr = off + rs;
+	int32_t dataPos = vAddr & 0x3;
+	uint32_t pAddr;
+	if (!load(vAddr, pAddr))
+		return;
+
+	gpr[static_cast<int>(inst.rt())] =
+		static_cast<uint8_t>(pAddr >> (24 - dataPos * 8));
 }
 
-void Interpreter::SRL(const Instruction &inst)
+void Interpreter::LH(const PackedInstruction &inst)
 {
-	if (inst.rt && inst.rd && inst.shift) {
-		uint32_t rt =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rt)]);
-		int32_t rd = static_cast<int>(*inst.rd);
-		int32_t sa = static_cast<int>(*inst.shift);
-		gpr[rd] = static_cast<int32_t>(rt >> sa);
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t off = static_cast<int>(inst.off());
+	int32_t vAddr = off + rs;
+	int32_t shortPos = vAddr & 0x1;
+	uint32_t pAddr;
+	if (!load(vAddr, pAddr))
+		return;
+
+	gpr[static_cast<int>(inst.rt())] =
+		static_cast<int16_t>(pAddr >> (16 - shortPos * 16));
 }
 
-void Interpreter::SRLV(const Instruction &inst)
+void Interpreter::LHU(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		uint32_t rt =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rt)]);
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = static_cast<int32_t>(rt >> rs);
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t off = static_cast<int>(inst.off());
+	int32_t vAddr = off + rs;
+	int32_t shortPos = vAddr & 0x1;
+	uint32_t pAddr;
+	if (!load(vAddr, pAddr))
+		return;
+
+	gpr[static_cast<int>(inst.rt())] =
+		static_cast<uint16_t>(pAddr >> (16 - shortPos * 16));
 }
 
-void Interpreter::Sub(const Instruction &inst)
+void Interpreter::LUI(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = rs - rt;
-	}
+	uint32_t imm = static_cast<uint32_t>(inst.imm());
+	gpr[static_cast<int>(inst.rt())] = static_cast<int32_t>(imm << 16);
 }
 
-void Interpreter::SubU(const Instruction &inst)
+void Interpreter::LW(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		uint32_t rs =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rs)]);
-		uint32_t rt =
-			static_cast<uint32_t>(gpr[static_cast<int>(*inst.rt)]);
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = static_cast<int32_t>(rs - rt);
-	}
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t off = static_cast<int>(inst.off());
+	int32_t vAddr = off + rs;
+	uint32_t value;
+	if (!load(vAddr, value))
+		return;
+
+	gpr[static_cast<int>(inst.rt())] = static_cast<int32_t>(value);
 }
 
-void Interpreter::SW(const Instruction &inst)
+void Interpreter::MFHI(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.off) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t off = static_cast<int>(*inst.off);
-		int32_t vAddr = off + rs;
-		memory.write(vAddr, static_cast<uint32_t>(rt));
-	}
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = hi;
 }
 
-void Interpreter::Xor(const Instruction &inst)
+void Interpreter::MFLO(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.rd) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t rt = gpr[static_cast<int>(*inst.rt)];
-		int32_t rd = static_cast<int>(*inst.rd);
-		gpr[rd] = rs ^ rt;
-	}
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = lo;
+}
+
+void Interpreter::MTHI(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	hi = rs;
+}
+
+void Interpreter::MTLO(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	lo = rs;
+}
+
+void Interpreter::Mult(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int64_t val = static_cast<int64_t>(rs) * static_cast<int64_t>(rt);
+	lo = static_cast<int32_t>(val);
+	hi = static_cast<int32_t>(val >> 32);
+}
+
+void Interpreter::MultU(const PackedInstruction &inst)
+{
+	uint32_t rs = static_cast<uint32_t>(gpr[static_cast<int>(inst.rs())]);
+	uint32_t rt = static_cast<uint32_t>(gpr[static_cast<int>(inst.rt())]);
+	uint64_t val = static_cast<uint64_t>(rs) * static_cast<uint64_t>(rt);
+	lo = static_cast<int32_t>(val);
+	hi = static_cast<int32_t>(val >> 32);
+}
+
+void Interpreter::NOr(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = ~(rs | rt);
+}
+
+void Interpreter::Or(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = rs | rt;
+}
+
+void Interpreter::OrI(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t imm = static_cast<int>(inst.imm());
+	int32_t rt = static_cast<int>(inst.rt());
+	gpr[rt] = rs | imm;
+}
+
+void Interpreter::SB(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t off = static_cast<int>(inst.off());
+	int32_t vAddr = off + rs;
+	int32_t dataPos = vAddr & 0x3;
+	if (!memory.write(vAddr, static_cast<uint8_t>(rt), dataPos))
+		faults |= FAULT_STORE;
+}
+
+void Interpreter::SH(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t off = static_cast<int>(inst.off());
+	int32_t vAddr = off + rs;
+	int32_t shortPos = vAddr & 0x1;
+	if (!memory.write(vAddr, static_cast<uint16_t>(rt), shortPos))
+		faults |= FAULT_STORE;
+}
+
+void Interpreter::SLL(const PackedInstruction &inst)
+{
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	int32_t sa = static_cast<int>(inst.shift());
+	gpr[rd] = static_cast<int32_t>(static_cast<uint32_t>(rt) << sa);
+}
+
+void Interpreter::SLLV(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = static_cast<int32_t>(static_cast<uint32_t>(rt)
+				       << (rs & 0x1F));
+}
+
+void Interpreter::SLT(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = (rs < rt) ? 1 : 0;
+}
+
+void Interpreter::SLTI(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t imm = static_cast<int>(inst.imm());
+	int32_t rt = static_cast<int>(inst.rt());
+	gpr[rt] = (rs < imm) ? 1 : 0;
+}
+
+void Interpreter::SLTIU(const PackedInstruction &inst)
+{
+	uint32_t rs = static_cast<uint32_t>(gpr[static_cast<int>(inst.rs())]);
+	uint32_t imm = static_cast<uint32_t>(inst.imm());
+	int32_t rt = static_cast<int>(inst.rt());
+	gpr[rt] = (rs < imm) ? 1 : 0;
+}
+
+void Interpreter::SLTU(const PackedInstruction &inst)
+{
+	uint32_t rs = static_cast<uint32_t>(gpr[static_cast<int>(inst.rs())]);
+	uint32_t rt = static_cast<uint32_t>(gpr[static_cast<int>(inst.rt())]);
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = (rs < rt) ? 1 : 0;
+}
+
+void Interpreter::SRA(const PackedInstruction &inst)
+{
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	int32_t sa = static_cast<int>(inst.shift());
+	gpr[rd] = rt >> sa;
+}
+
+void Interpreter::SRAV(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = rt >> (rs & 0x1F);
+}
+
+void Interpreter::SRL(const PackedInstruction &inst)
+{
+	uint32_t rt = static_cast<uint32_t>(gpr[static_cast<int>(inst.rt())]);
+	int32_t rd = static_cast<int>(inst.rd());
+	int32_t sa = static_cast<int>(inst.shift());
+	gpr[rd] = static_cast<int32_t>(rt >> sa);
+}
+
+void Interpreter::SRLV(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	uint32_t rt = static_cast<uint32_t>(gpr[static_cast<int>(inst.rt())]);
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = static_cast<int32_t>(rt >> (rs & 0x1F));
+}
+
+void Interpreter::Sub(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = rs - rt;
 }
 
-void Interpreter::XorI(const Instruction &inst)
+void Interpreter::SubU(const PackedInstruction &inst)
 {
-	if (inst.rs && inst.rt && inst.imm) {
-		int32_t rs = gpr[static_cast<int>(*inst.rs)];
-		int32_t imm = static_cast<int>(*inst.imm);
-		int32_t rt = static_cast<int>(*inst.rt);
-		gpr[rt] = rs ^ imm;
+	uint32_t rs = static_cast<uint32_t>(gpr[static_cast<int>(inst.rs())]);
+	uint32_t rt = static_cast<uint32_t>(gpr[static_cast<int>(inst.rt())]);
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = static_cast<int32_t>(rs - rt);
+}
+
+void Interpreter::SW(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t off = static_cast<int>(inst.off());
+	int32_t vAddr = off + rs;
+	if (!memory.write(vAddr, static_cast<uint32_t>(rt)))
+		faults |= FAULT_STORE;
+}
+
+void Interpreter::Xor(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t rt = gpr[static_cast<int>(inst.rt())];
+	int32_t rd = static_cast<int>(inst.rd());
+	gpr[rd] = rs ^ rt;
+}
+
+void Interpreter::XorI(const PackedInstruction &inst)
+{
+	int32_t rs = gpr[static_cast<int>(inst.rs())];
+	int32_t imm = static_cast<int>(inst.imm());
+	int32_t rt = static_cast<int>(inst.rt());
+	gpr[rt] = rs ^ imm;
+}
+
+const std::array<Interpreter::Performer, CmdCount> Interpreter::sCmdToFunc =
+	MakeCmdTable<Interpreter::Performer>(nullptr, {
+		{CMD_ADD, &Interpreter::Add},
+		{CMD_ADDU, &Interpreter::Add},
+		{CMD_ADDI, &Interpreter::AddI},
+		{CMD_ADDIU, &Interpreter::AddI},
+		{CMD_AND, &Interpreter::And},
+		{CMD_ANDI, &Interpreter::AndI},
+		{CMD_BEQ, &Interpreter::BEQ},
+		{CMD_BEQL, &Interpreter::BEQL},
+		{CMD_BGEZ, &Interpreter::BGEZ},
+		{CMD_BGEZAL, &Interpreter::BGEZAL},
+		{CMD_BGEZALL, &Interpreter::BGEZALL},
+		{CMD_BGEZL, &Interpreter::BGEZL},
+		{CMD_BGTZ, &Interpreter::BGTZ},
+		{CMD_BGTZL, &Interpreter::BGTZL},
+		{CMD_BLEZ, &Interpreter::BLEZ},
+		{CMD_BLEZL, &Interpreter::BLEZL},
+		{CMD_BLTZ, &Interpreter::BLTZ},
+		{CMD_BLTZAL, &Interpreter::BLTZAL},
+		{CMD_BLTZALL, &Interpreter::BLTZALL},
+		{CMD_BLTZL, &Interpreter::BLTZL},
+		{CMD_BNE, &Interpreter::BNE},
+		{CMD_BNEL, &Interpreter::BNEL},
+		{CMD_DIV, &Interpreter::Div},
+		{CMD_DIVU, &Interpreter::DivU},
+		{CMD_J, &Interpreter::J},
+		{CMD_JAL, &Interpreter::JAL},
+		{CMD_JALR, &Interpreter::JALR},
+		{CMD_JR, &Interpreter::JR},
+		{CMD_LB, &Interpreter::LB},
+		{CMD_LBU, &Interpreter::LBU},
+		{CMD_LH, &Interpreter::LH},
+		{CMD_LHU, &Interpreter::LHU},
+		{CMD_LUI, &Interpreter::LUI},
+		{CMD_LW, &Interpreter::LW},
+		{CMD_LWU, &Interpreter::LW},
+		{CMD_MFHI, &Interpreter::MFHI},
+		{CMD_MFLO, &Interpreter::MFLO},
+		{CMD_MTHI, &Interpreter::MTHI},
+		{CMD_MTLO, &Interpreter::MTLO},
+		{CMD_MULT, &Interpreter::Mult},
+		{CMD_MULTU, &Interpreter::MultU},
+		{CMD_NOR, &Interpreter::NOr},
+		{CMD_OR, &Interpreter::Or},
+		{CMD_ORI, &Interpreter::OrI},
+		{CMD_SB, &Interpreter::SB},
+		{CMD_SH, &Interpreter::SH},
+		{CMD_SLLV, &Interpreter::SLLV},
+		{CMD_SLT, &Interpreter::SLT},
+		{CMD_SLTI, &Interpreter::SLTI},
+		{CMD_SLTIU, &Interpreter::SLTIU},
+		{CMD_SLTU, &Interpreter::SLTU},
+		{CMD_SRA, &Interpreter::SRA},
+		{CMD_SRAV, &Interpreter::SRAV},
+		{CMD_SRL, &Interpreter::SRL},
+		{CMD_SRLV, &Interpreter::SRLV},
+		{CMD_SUB, &Interpreter::Sub},
+		{CMD_SUBU, &Interpreter::Sub},
+		{CMD_SW, &Interpreter::SW},
+		{CMD_XOR, &Interpreter::Xor},
+		{CMD_XORI, &Interpreter::XorI},
+	});
+
+void Interpreter::reset(uint32_t newPc, std::optional<uint32_t> stopPc)
+{
+	std::fill(std::begin(gpr), std::end(gpr), 0);
+	lo = 0;
+	hi = 0;
+	pc = newPc;
+	faults = 0;
+	stopPc_ = stopPc;
+	visitedCount_ = 0;
+	delayed_ = false;
+	memory.reset();
+}
+
+void Interpreter::execute(const PackedInstruction &inst)
+{
+	bool delaySlot = delayed_;
+	delayed_ = false;
+	Performer perform = sCmdToFunc[inst.cmd()];
+	if (perform) {
+		(this->*perform)(inst);
 	}
+	// Writes to R0 are dropped
+	gpr[REG_R0] = 0;
+	if (delaySlot)
+		pc = delayedPc_;
 }
 
-const std::map<Cmd, Interpreter::Performer> Interpreter::sCmdToFunc{
-	{CMD_ADD, &Interpreter::Add},     {CMD_ADDU, &Interpreter::Add},
-	{CMD_ADDI, &Interpreter::AddI},   {CMD_ADDIU, &Interpreter::AddI},
-	{CMD_AND, &Interpreter::And},     {CMD_ANDI, &Interpreter::AndI},
-	{CMD_DIV, &Interpreter::Div},     {CMD_DIVU, &Interpreter::DivU},
-	{CMD_LB, &Interpreter::LB},       {CMD_LBU, &Interpreter::LBU},
-	{CMD_LH, &Interpreter::LH},       {CMD_LHU, &Interpreter::LHU},
-	{CMD_LUI, &Interpreter::LUI},     {CMD_LW, &Interpreter::LW},
-	{CMD_LWU, &Interpreter::LW},      {CMD_MFHI, &Interpreter::MFHI},
-	{CMD_MFLO, &Interpreter::MFLO},   {CMD_MTHI, &Interpreter::MTHI},
-	{CMD_MTLO, &Interpreter::MTLO},   {CMD_MULT, &Interpreter::Mult},
-	{CMD_MULTU, &Interpreter::MultU}, {CMD_NOR, &Interpreter::NOr},
-	{CMD_OR, &Interpreter::Or},       {CMD_ORI, &Interpreter::OrI},
-	{CMD_SB, &Interpreter::SB},       {CMD_SH, &Interpreter::SH},
-	{CMD_SLLV, &Interpreter::SLLV},   {CMD_SLT, &Interpreter::SLT},
-	{CMD_SLTI, &Interpreter::SLTI},   {CMD_SLTIU, &Interpreter::SLTIU},
-	{CMD_SLTU, &Interpreter::SLTU},   {CMD_SRA, &Interpreter::SRA},
-	{CMD_SRAV, &Interpreter::SRAV},   {CMD_SRL, &Interpreter::SRL},
-	{CMD_SRLV, &Interpreter::SRLV},   {CMD_SUB, &Interpreter::Sub},
-	{CMD_SUBU, &Interpreter::Sub},    {CMD_SW, &Interpreter::SW},
-	{CMD_XOR, &Interpreter::Xor},     {CMD_XORI, &Interpreter::XorI},
-};
+std::optional<PackedInstruction> Interpreter::getInstruction()
+{
+	uint32_t cmd;
+	if (!memory.read(pc, cmd)) {
+		faults |= FAULT_FETCH;
+		return std::nullopt;
+	}
+	pc += 4;
 
-void Interpreter::execute(const Instruction &inst)
-try {
-	auto perform = sCmdToFunc.find(inst.cmd);
-	if (perform != sCmdToFunc.end()) {
-		(this->*(perform->second))(inst);
+	// Nothing is executed for unsupported words, a delay slot still ends
+	std::optional<PackedInstruction> inst = decodePacked(cmd);
+	if (!inst && delayed_) {
+		delayed_ = false;
+		pc = delayedPc_;
 	}
-} catch (...) {
+	return inst;
 }
 
-std::optional<Instruction> Interpreter::getInstruction()
+#if defined(__GNUC__)
+#define MIPS_INTERPRETER_COMPUTED_GOTO
+#endif
+
+// Handlers of 'run', one per distinct Performer in 'sCmdToFunc'
+enum RunOp : uint8_t {
+	RUN_NONE,
+	RUN_ADD,
+	RUN_ADDI,
+	RUN_AND,
+	RUN_ANDI,
+	RUN_BEQ,
+	RUN_BEQL,
+	RUN_BGEZ,
+	RUN_BGEZAL,
+	RUN_BGEZALL,
+	RUN_BGEZL,
+	RUN_BGTZ,
+	RUN_BGTZL,
+	RUN_BLEZ,
+	RUN_BLEZL,
+	RUN_BLTZ,
+	RUN_BLTZAL,
+	RUN_BLTZALL,
+	RUN_BLTZL,
+	RUN_BNE,
+	RUN_BNEL,
+	RUN_DIV,
+	RUN_DIVU,
+	RUN_J,
+	RUN_JAL,
+	RUN_JALR,
+	RUN_JR,
+	RUN_LB,
+	RUN_LBU,
+	RUN_LH,
+	RUN_LHU,
+	RUN_LUI,
+	RUN_LW,
+	RUN_MFHI,
+	RUN_MFLO,
+	RUN_MTHI,
+	RUN_MTLO,
+	RUN_MULT,
+	RUN_MULTU,
+	RUN_NOR,
+	RUN_OR,
+	RUN_ORI,
+	RUN_SB,
+	RUN_SH,
+	RUN_SLLV,
+	RUN_SLT,
+	RUN_SLTI,
+	RUN_SLTIU,
+	RUN_SLTU,
+	RUN_SRA,
+	RUN_SRAV,
+	RUN_SRL,
+	RUN_SRLV,
+	RUN_SUB,
+	RUN_SW,
+	RUN_XOR,
+	RUN_XORI,
+};
+
+// Only the primary opcode, SPECIAL functions and REGIMM branches are ever
+// looked up, all index this by the Cmd they decode to
+static constexpr std::array<RunOp, CmdCount> sCmdToRunOp =
+	MakeCmdTable<RunOp>(RUN_NONE, {
+		{CMD_ADD, RUN_ADD},
+		{CMD_ADDI, RUN_ADDI},
+		{CMD_ADDIU, RUN_ADDI},
+		{CMD_ADDU, RUN_ADD},
+		{CMD_AND, RUN_AND},
+		{CMD_ANDI, RUN_ANDI},
+		{CMD_BEQ, RUN_BEQ},
+		{CMD_BEQL, RUN_BEQL},
+		{CMD_BGEZ, RUN_BGEZ},
+		{CMD_BGEZAL, RUN_BGEZAL},
+		{CMD_BGEZALL, RUN_BGEZALL},
+		{CMD_BGEZL, RUN_BGEZL},
+		{CMD_BGTZ, RUN_BGTZ},
+		{CMD_BGTZL, RUN_BGTZL},
+		{CMD_BLEZ, RUN_BLEZ},
+		{CMD_BLEZL, RUN_BLEZL},
+		{CMD_BLTZ, RUN_BLTZ},
+		{CMD_BLTZAL, RUN_BLTZAL},
+		{CMD_BLTZALL, RUN_BLTZALL},
+		{CMD_BLTZL, RUN_BLTZL},
+		{CMD_BNE, RUN_BNE},
+		{CMD_BNEL, RUN_BNEL},
+		{CMD_DIV, RUN_DIV},
+		{CMD_DIVU, RUN_DIVU},
+		{CMD_J, RUN_J},
+		{CMD_JAL, RUN_JAL},
+		{CMD_JALR, RUN_JALR},
+		{CMD_JR, RUN_JR},
+		{CMD_LB, RUN_LB},
+		{CMD_LBU, RUN_LBU},
+		{CMD_LH, RUN_LH},
+		{CMD_LHU, RUN_LHU},
+		{CMD_LUI, RUN_LUI},
+		{CMD_LW, RUN_LW},
+		{CMD_LWU, RUN_LW},
+		{CMD_MFHI, RUN_MFHI},
+		{CMD_MFLO, RUN_MFLO},
+		{CMD_MTHI, RUN_MTHI},
+		{CMD_MTLO, RUN_MTLO},
+		{CMD_MULT, RUN_MULT},
+		{CMD_MULTU, RUN_MULTU},
+		{CMD_NOR, RUN_NOR},
+		{CMD_OR, RUN_OR},
+		{CMD_ORI, RUN_ORI},
+		{CMD_SB, RUN_SB},
+		{CMD_SH, RUN_SH},
+		{CMD_SLLV, RUN_SLLV},
+		{CMD_SLT, RUN_SLT},
+		{CMD_SLTI, RUN_SLTI},
+		{CMD_SLTIU, RUN_SLTIU},
+		{CMD_SLTU, RUN_SLTU},
+		{CMD_SRA, RUN_SRA},
+		{CMD_SRAV, RUN_SRAV},
+		{CMD_SRL, RUN_SRL},
+		{CMD_SRLV, RUN_SRLV},
+		{CMD_SUB, RUN_SUB},
+		{CMD_SUBU, RUN_SUB},
+		{CMD_SW, RUN_SW},
+		{CMD_XOR, RUN_XOR},
+		{CMD_XORI, RUN_XORI},
+	});
+
+// The handlers below repeat their Performer for the fields decoded straight
+// from the word, 'execute' stays the reference they are checked against
+uint32_t Interpreter::run(uint32_t count, std::vector<uint32_t> *storedWords)
 {
-	uint32_t cmd = memory.read(static_cast<int>(pc));
+#ifdef MIPS_INTERPRETER_COMPUTED_GOTO
+	// In RunOp order
+	static const void *const sLabels[] = {
+		&&op_RUN_NONE,    &&op_RUN_ADD,     &&op_RUN_ADDI,
+		&&op_RUN_AND,     &&op_RUN_ANDI,    &&op_RUN_BEQ,
+		&&op_RUN_BEQL,    &&op_RUN_BGEZ,    &&op_RUN_BGEZAL,
+		&&op_RUN_BGEZALL, &&op_RUN_BGEZL,   &&op_RUN_BGTZ,
+		&&op_RUN_BGTZL,   &&op_RUN_BLEZ,    &&op_RUN_BLEZL,
+		&&op_RUN_BLTZ,    &&op_RUN_BLTZAL,  &&op_RUN_BLTZALL,
+		&&op_RUN_BLTZL,   &&op_RUN_BNE,     &&op_RUN_BNEL,
+		&&op_RUN_DIV,     &&op_RUN_DIVU,    &&op_RUN_J,
+		&&op_RUN_JAL,     &&op_RUN_JALR,    &&op_RUN_JR,
+		&&op_RUN_LB,      &&op_RUN_LBU,     &&op_RUN_LH,
+		&&op_RUN_LHU,     &&op_RUN_LUI,     &&op_RUN_LW,
+		&&op_RUN_MFHI,    &&op_RUN_MFLO,    &&op_RUN_MTHI,
+		&&op_RUN_MTLO,    &&op_RUN_MULT,    &&op_RUN_MULTU,
+		&&op_RUN_NOR,     &&op_RUN_OR,      &&op_RUN_ORI,
+		&&op_RUN_SB,      &&op_RUN_SH,      &&op_RUN_SLLV,
+		&&op_RUN_SLT,     &&op_RUN_SLTI,    &&op_RUN_SLTIU,
+		&&op_RUN_SLTU,    &&op_RUN_SRA,     &&op_RUN_SRAV,
+		&&op_RUN_SRL,     &&op_RUN_SRLV,    &&op_RUN_SUB,
+		&&op_RUN_SW,      &&op_RUN_XOR,     &&op_RUN_XORI,
+	};
+	static_assert(sizeof(sLabels) / sizeof(*sLabels) == RUN_XORI + 1,
+		      "every RunOp needs a label");
+#define RUN_CASE(op) op_##op:
+#else
+#define RUN_CASE(op) case op:
+#endif
+
+	uint32_t executed = 0;
+	uint32_t word, cmd;
+	DecodedInstruction decoded;
+	const DecodedInstruction *inst;
+	uint32_t rs, rt, rd, sa;
+	int32_t imm, vAddr;
+	uint32_t value, target;
+	bool delaySlot = false;
+
+next:
+	// Writes to R0 are dropped
+	gpr[REG_R0] = 0;
+	if (delaySlot) {
+		pc = delayedPc_;
+		delaySlot = false;
+	}
+	if (executed == count || (executed && pc == stopPc_))
+		return executed;
+
+	// Entries are only made from and used for RAM as it is in the dump, the
+	// stack and stored words always take the slow path
+	inst = &decodeCache_[(pc >> 2) % DecodeCacheSize];
+	if (inst->pc == pc && !memory.ramModified()) {
+		decodeCacheHits++;
+	} else {
+		if (!memory.read(pc, word)) {
+			faults |= FAULT_FETCH;
+			return executed;
+		}
+
+		decodeCacheMisses++;
+		decoded.pc = pc;
+		cmd = word >> 26;
+		if (cmd == OP_SPECIAL)
+			cmd = CMD_REG | (word & 0x3F);
+		else if (cmd == OP_REGIMM)
+			cmd = CMD_REGIMM | ((word >> 16) & 0x1F);
+		else
+			cmd |= CMD_IMM;
+		decoded.op = sCmdToRunOp[cmd];
+		decoded.rs = static_cast<uint8_t>((word >> 21) & 0x1F);
+		decoded.rt = static_cast<uint8_t>((word >> 16) & 0x1F);
+		decoded.rd = static_cast<uint8_t>((word >> 11) & 0x1F);
+		decoded.sa = static_cast<uint8_t>((word >> 6) & 0x1F);
+		decoded.imm = static_cast<int16_t>(word & 0xFFFF);
+		if (!memory.ramModified() && memory.mapsRAM(pc))
+			decodeCache_[(pc >> 2) % DecodeCacheSize] = decoded;
+		inst = &decoded;
+	}
 	pc += 4;
+	executed++;
+	delaySlot = delayed_;
+	delayed_ = false;
 
-	try {
-		return decodeInstruction(cmd);
-	} catch (...) {
-		return std::nullopt;
+	rs = inst->rs;
+	rt = inst->rt;
+	rd = inst->rd;
+	sa = inst->sa;
+	imm = inst->imm;
+	// Loads and stores take the offset as decoded, shifted by 2
+	vAddr = static_cast<int32_t>(static_cast<uint32_t>(imm) << 2) +
+		gpr[rs];
+	// Branches too, from the delay slot
+	target = pc + (static_cast<uint32_t>(imm) << 2);
+
+#ifdef MIPS_INTERPRETER_COMPUTED_GOTO
+	goto *sLabels[inst->op];
+#else
+	switch (static_cast<RunOp>(inst->op))
+#endif
+	{
+		RUN_CASE(RUN_NONE)
+		goto next;
+		RUN_CASE(RUN_ADD)
+		gpr[rd] = gpr[rs] + gpr[rt];
+		goto next;
+		RUN_CASE(RUN_ADDI)
+		gpr[rt] = gpr[rs] + imm;
+		goto next;
+		RUN_CASE(RUN_AND)
+		gpr[rd] = gpr[rs] & gpr[rt];
+		goto next;
+		RUN_CASE(RUN_ANDI)
+		gpr[rt] = gpr[rs] & imm;
+		goto next;
+		RUN_CASE(RUN_BEQ)
+		branch(gpr[rs] == gpr[rt], false, target);
+		goto next;
+		RUN_CASE(RUN_BEQL)
+		branch(gpr[rs] == gpr[rt], true, target);
+		goto next;
+		RUN_CASE(RUN_BGEZ)
+		branch(gpr[rs] >= 0, false, target);
+		goto next;
+		RUN_CASE(RUN_BGEZAL)
+		link(gpr[rs] >= 0, false);
+		goto next;
+		RUN_CASE(RUN_BGEZALL)
+		link(gpr[rs] >= 0, true);
+		goto next;
+		RUN_CASE(RUN_BGEZL)
+		branch(gpr[rs] >= 0, true, target);
+		goto next;
+		RUN_CASE(RUN_BGTZ)
+		branch(gpr[rs] > 0, false, target);
+		goto next;
+		RUN_CASE(RUN_BGTZL)
+		branch(gpr[rs] > 0, true, target);
+		goto next;
+		RUN_CASE(RUN_BLEZ)
+		branch(gpr[rs] <= 0, false, target);
+		goto next;
+		RUN_CASE(RUN_BLEZL)
+		branch(gpr[rs] <= 0, true, target);
+		goto next;
+		RUN_CASE(RUN_BLTZ)
+		branch(gpr[rs] < 0, false, target);
+		goto next;
+		RUN_CASE(RUN_BLTZAL)
+		link(gpr[rs] < 0, false);
+		goto next;
+		RUN_CASE(RUN_BLTZALL)
+		link(gpr[rs] < 0, true);
+		goto next;
+		RUN_CASE(RUN_BLTZL)
+		branch(gpr[rs] < 0, true, target);
+		goto next;
+		RUN_CASE(RUN_BNE)
+		branch(gpr[rs] != gpr[rt], false, target);
+		goto next;
+		RUN_CASE(RUN_BNEL)
+		branch(gpr[rs] != gpr[rt], true, target);
+		goto next;
+		RUN_CASE(RUN_DIV)
+		if (0 == gpr[rt]) {
+			faults |= FAULT_DIVIDE_BY_ZERO;
+			goto next;
+		}
+		lo = static_cast<int32_t>(static_cast<int64_t>(gpr[rs]) %
+					  gpr[rt]);
+		hi = static_cast<int32_t>(static_cast<int64_t>(gpr[rs]) /
+					  gpr[rt]);
+		goto next;
+		RUN_CASE(RUN_DIVU)
+		if (0 == gpr[rt]) {
+			faults |= FAULT_DIVIDE_BY_ZERO;
+			goto next;
+		}
+		lo = static_cast<int32_t>(static_cast<uint32_t>(gpr[rs]) %
+					  static_cast<uint32_t>(gpr[rt]));
+		hi = static_cast<int32_t>(static_cast<uint32_t>(gpr[rs]) /
+					  static_cast<uint32_t>(gpr[rt]));
+		goto next;
+		RUN_CASE(RUN_J)
+		// The target index spans every field after the opcode
+		branch(true, false,
+		       (pc & 0xF0000000) | (rs << 23) | (rt << 18) |
+			       ((static_cast<uint32_t>(imm) & 0xFFFF) << 2));
+		goto next;
+		RUN_CASE(RUN_JAL)
+		gpr[REG_RA] = static_cast<int32_t>(pc + 4);
+		goto next;
+		RUN_CASE(RUN_JALR)
+		gpr[rd] = static_cast<int32_t>(pc + 4);
+		goto next;
+		RUN_CASE(RUN_JR)
+		branch(true, false, static_cast<uint32_t>(gpr[rs]));
+		goto next;
+		RUN_CASE(RUN_LB)
+		if (load(vAddr, value))
+			gpr[rt] = static_cast<int8_t>(
+				value >> (24 - (vAddr & 0x3) * 8));
+		goto next;
+		RUN_CASE(RUN_LBU)
+		if (load(vAddr, value))
+			gpr[rt] = static_cast<uint8_t>(
+				value >> (24 - (vAddr & 0x3) * 8));
+		goto next;
+		RUN_CASE(RUN_LH)
+		if (load(vAddr, value))
+			gpr[rt] = static_cast<int16_t>(
+				value >> (16 - (vAddr & 0x1) * 16));
+		goto next;
+		RUN_CASE(RUN_LHU)
+		if (load(vAddr, value))
+			gpr[rt] = static_cast<uint16_t>(
+				value >> (16 - (vAddr & 0x1) * 16));
+		goto next;
+		RUN_CASE(RUN_LUI)
+		gpr[rt] = static_cast<int32_t>(static_cast<uint32_t>(imm)
+					       << 16);
+		goto next;
+		RUN_CASE(RUN_LW)
+		if (load(vAddr, value))
+			gpr[rt] = static_cast<int32_t>(value);
+		goto next;
+		RUN_CASE(RUN_MFHI)
+		gpr[rd] = hi;
+		goto next;
+		RUN_CASE(RUN_MFLO)
+		gpr[rd] = lo;
+		goto next;
+		RUN_CASE(RUN_MTHI)
+		hi = gpr[rs];
+		goto next;
+		RUN_CASE(RUN_MTLO)
+		lo = gpr[rs];
+		goto next;
+		RUN_CASE(RUN_MULT)
+		{
+			int64_t val = static_cast<int64_t>(gpr[rs]) *
+				      static_cast<int64_t>(gpr[rt]);
+			lo = static_cast<int32_t>(val);
+			hi = static_cast<int32_t>(val >> 32);
+		}
+		goto next;
+		RUN_CASE(RUN_MULTU)
+		{
+			uint64_t val = static_cast<uint64_t>(
+					       static_cast<uint32_t>(gpr[rs])) *
+				       static_cast<uint32_t>(gpr[rt]);
+			lo = static_cast<int32_t>(val);
+			hi = static_cast<int32_t>(val >> 32);
+		}
+		goto next;
+		RUN_CASE(RUN_NOR)
+		gpr[rd] = ~(gpr[rs] | gpr[rt]);
+		goto next;
+		RUN_CASE(RUN_OR)
+		gpr[rd] = gpr[rs] | gpr[rt];
+		goto next;
+		RUN_CASE(RUN_ORI)
+		gpr[rt] = gpr[rs] | imm;
+		goto next;
+		RUN_CASE(RUN_SB)
+		if (!memory.write(vAddr, static_cast<uint8_t>(gpr[rt]),
+				  vAddr & 0x3))
+			faults |= FAULT_STORE;
+		goto next;
+		RUN_CASE(RUN_SH)
+		if (!memory.write(vAddr, static_cast<uint16_t>(gpr[rt]),
+				  vAddr & 0x1))
+			faults |= FAULT_STORE;
+		goto next;
+		RUN_CASE(RUN_SLLV)
+		gpr[rd] = static_cast<int32_t>(static_cast<uint32_t>(gpr[rt])
+					       << (gpr[rs] & 0x1F));
+		goto next;
+		RUN_CASE(RUN_SLT)
+		gpr[rd] = (gpr[rs] < gpr[rt]) ? 1 : 0;
+		goto next;
+		RUN_CASE(RUN_SLTI)
+		gpr[rt] = (gpr[rs] < imm) ? 1 : 0;
+		goto next;
+		RUN_CASE(RUN_SLTIU)
+		gpr[rt] = (static_cast<uint32_t>(gpr[rs]) <
+			   static_cast<uint32_t>(imm))
+				  ? 1
+				  : 0;
+		goto next;
+		RUN_CASE(RUN_SLTU)
+		gpr[rd] = (static_cast<uint32_t>(gpr[rs]) <
+			   static_cast<uint32_t>(gpr[rt]))
+				  ? 1
+				  : 0;
+		goto next;
+		RUN_CASE(RUN_SRA)
+		gpr[rd] = gpr[rt] >> sa;
+		goto next;
+		RUN_CASE(RUN_SRAV)
+		gpr[rd] = gpr[rt] >> (gpr[rs] & 0x1F);
+		goto next;
+		RUN_CASE(RUN_SRL)
+		gpr[rd] = static_cast<int32_t>(static_cast<uint32_t>(gpr[rt]) >>
+					       sa);
+		goto next;
+		RUN_CASE(RUN_SRLV)
+		gpr[rd] = static_cast<int32_t>(static_cast<uint32_t>(gpr[rt]) >>
+					       (gpr[rs] & 0x1F));
+		goto next;
+		RUN_CASE(RUN_SUB)
+		gpr[rd] = gpr[rs] - gpr[rt];
+		goto next;
+		RUN_CASE(RUN_SW)
+		if (!memory.write(vAddr, static_cast<uint32_t>(gpr[rt])))
+			faults |= FAULT_STORE;
+		if (storedWords)
+			storedWords->push_back(static_cast<uint32_t>(gpr[rt]));
+		goto next;
+		RUN_CASE(RUN_XOR)
+		gpr[rd] = gpr[rs] ^ gpr[rt];
+		goto next;
+		RUN_CASE(RUN_XORI)
+		gpr[rt] = gpr[rs] ^ imm;
+		goto next;
 	}
+
+#undef RUN_CASE
+	return executed;
 }
 }
\ No newline at end of file
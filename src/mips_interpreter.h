@@ -6,65 +6,160 @@
 
 #include <stdint.h>
 
-#include <map>
+#include <array>
+#include <optional>
+#include <vector>
 
 namespace MIPS {
 
+// Faulting instructions have no effect, they only set their bit in
+// 'Interpreter::faults'
+enum Fault {
+	FAULT_FETCH = 1 << 0,
+	FAULT_LOAD = 1 << 1,
+	FAULT_STORE = 1 << 2,
+	FAULT_DIVIDE_BY_ZERO = 1 << 3,
+	// A branch or jump to where an earlier one went since the reset, or to
+	// more places than are tracked. It is not taken, so loops run at most
+	// twice and code following the jumps never runs for long.
+	FAULT_LOOP = 1 << 4,
+};
+
+// Branches and jumps take effect after their delay slot and likely branches
+// that are not taken skip it. Calls are stepped over: JAL, JALR and the
+// taken linking branches only set the link register and the callee never
+// runs.
 class Interpreter {
 public:
 	int32_t gpr[32]{};
 	int32_t lo{};
 	int32_t hi{};
 	uint32_t pc{};
+	// Every Fault seen so far, stays set until cleared by the caller
+	uint32_t faults{};
 	Memory memory;
+	// Instructions 'run' found in its decode cache or had to decode, the
+	// cache and these live as long as the Interpreter and survive 'reset'
+	uint64_t decodeCacheHits{};
+	uint64_t decodeCacheMisses{};
+
+	Interpreter(const std::vector<uint32_t> &ram);
 
-	Interpreter(const std::vector<uint32_t> &ram) : memory(ram) {}
+	// Back to the state right after construction with 'pc' at 'newPc', so
+	// one Interpreter can run many snippets without reallocating. With
+	// 'stopPc', 'run' returns when it gets there and the next 'run' goes on
+	// from it. Branches before it are not taken to past it, since that path
+	// could not get there.
+	void reset(uint32_t newPc,
+		   std::optional<uint32_t> stopPc = std::nullopt);
 
-	using Performer = void (Interpreter::*)(const Instruction &);
+	using Performer = void (Interpreter::*)(const PackedInstruction &);
 
-	void execute(const Instruction &inst);
-	std::optional<Instruction> getInstruction();
+	void execute(const PackedInstruction &inst);
+	// Returns nothing for code that is not supported and on FAULT_FETCH
+	std::optional<PackedInstruction> getInstruction();
+
+	// Same as 'getInstruction' and 'execute' up to 'count' times but
+	// decodes and dispatches in a single loop, stops early on FAULT_FETCH.
+	// Every SW also appends the word it stores to 'storedWords' if given.
+	// Returns how many instructions were fetched.
+	uint32_t run(uint32_t count,
+		     std::vector<uint32_t> *storedWords = nullptr);
 
 private:
-	static const std::map<Cmd, Interpreter::Performer> sCmdToFunc;
-
-	void Add(const Instruction &inst);
-	void AddI(const Instruction &inst);
-	void And(const Instruction &inst);
-	void AndI(const Instruction &inst);
-	void Div(const Instruction &inst);
-	void DivU(const Instruction &inst);
-	void LB(const Instruction &inst);
-	void LBU(const Instruction &inst);
-	void LH(const Instruction &inst);
-	void LHU(const Instruction &inst);
-	void LUI(const Instruction &inst);
-	void LW(const Instruction &inst);
-	void MFHI(const Instruction &inst);
-	void MFLO(const Instruction &inst);
-	void MTHI(const Instruction &inst);
-	void MTLO(const Instruction &inst);
-	void Mult(const Instruction &inst);
-	void MultU(const Instruction &inst);
-	void NOr(const Instruction &inst);
-	void Or(const Instruction &inst);
-	void OrI(const Instruction &inst);
-	void SB(const Instruction &inst);
-	void SH(const Instruction &inst);
-	void SLL(const Instruction &inst);
-	void SLLV(const Instruction &inst);
-	void SLT(const Instruction &inst);
-	void SLTI(const Instruction &inst);
-	void SLTIU(const Instruction &inst);
-	void SLTU(const Instruction &inst);
-	void SRA(const Instruction &inst);
-	void SRAV(const Instruction &inst);
-	void SRL(const Instruction &inst);
-	void SRLV(const Instruction &inst);
-	void Sub(const Instruction &inst);
-	void SubU(const Instruction &inst);
-	void SW(const Instruction &inst);
-	void Xor(const Instruction &inst);
-	void XorI(const Instruction &inst);
+	// An instruction word as 'run' dispatches it
+	struct DecodedInstruction {
+		// Empty entries hold an address that indexes another entry, so
+		// no 'pc' a jump can reach matches them
+		uint32_t pc;
+		uint8_t op;
+		uint8_t rs;
+		uint8_t rt;
+		uint8_t rd;
+		uint8_t sa;
+		int16_t imm;
+	};
+
+	// Direct mapped by word address, big enough for the windows of one
+	// analysis to overlap in it
+	static const uint32_t DecodeCacheSize = 0x1000;
+	std::vector<DecodedInstruction> decodeCache_;
+
+	std::optional<uint32_t> stopPc_;
+	// Branch targets taken since the last reset
+	static const uint32_t MaxVisitedBlocks = 32;
+	uint32_t visited_[MaxVisitedBlocks];
+	uint32_t visitedCount_{};
+	// Set by a taken branch until its delay slot ran
+	bool delayed_{};
+	uint32_t delayedPc_{};
+
+	// Indexed by Cmd, nullptr for commands that are not interpreted
+	static const std::array<Performer, CmdCount> sCmdToFunc;
+
+	bool load(int32_t vAddr, uint32_t &value);
+	// For a branch with 'pc' at its delay slot
+	void branch(bool taken, bool likely, uint32_t target);
+	// For a linking branch, which is stepped over like JAL
+	void link(bool taken, bool likely);
+
+	void Add(const PackedInstruction &inst);
+	void AddI(const PackedInstruction &inst);
+	void And(const PackedInstruction &inst);
+	void AndI(const PackedInstruction &inst);
+	void BEQ(const PackedInstruction &inst);
+	void BEQL(const PackedInstruction &inst);
+	void BGEZ(const PackedInstruction &inst);
+	void BGEZAL(const PackedInstruction &inst);
+	void BGEZALL(const PackedInstruction &inst);
+	void BGEZL(const PackedInstruction &inst);
+	void BGTZ(const PackedInstruction &inst);
+	void BGTZL(const PackedInstruction &inst);
+	void BLEZ(const PackedInstruction &inst);
+	void BLEZL(const PackedInstruction &inst);
+	void BLTZ(const PackedInstruction &inst);
+	void BLTZAL(const PackedInstruction &inst);
+	void BLTZALL(const PackedInstruction &inst);
+	void BLTZL(const PackedInstruction &inst);
+	void BNE(const PackedInstruction &inst);
+	void BNEL(const PackedInstruction &inst);
+	void Div(const PackedInstruction &inst);
+	void DivU(const PackedInstruction &inst);
+	void J(const PackedInstruction &inst);
+	void JAL(const PackedInstruction &inst);
+	void JALR(const PackedInstruction &inst);
+	void JR(const PackedInstruction &inst);
+	void LB(const PackedInstruction &inst);
+	void LBU(const PackedInstruction &inst);
+	void LH(const PackedInstruction &inst);
+	void LHU(const PackedInstruction &inst);
+	void LUI(const PackedInstruction &inst);
+	void LW(const PackedInstruction &inst);
+	void MFHI(const PackedInstruction &inst);
+	void MFLO(const PackedInstruction &inst);
+	void MTHI(const PackedInstruction &inst);
+	void MTLO(const PackedInstruction &inst);
+	void Mult(const PackedInstruction &inst);
+	void MultU(const PackedInstruction &inst);
+	void NOr(const PackedInstruction &inst);
+	void Or(const PackedInstruction &inst);
+	void OrI(const PackedInstruction &inst);
+	void SB(const PackedInstruction &inst);
+	void SH(const PackedInstruction &inst);
+	void SLL(const PackedInstruction &inst);
+	void SLLV(const PackedInstruction &inst);
+	void SLT(const PackedInstruction &inst);
+	void SLTI(const PackedInstruction &inst);
+	void SLTIU(const PackedInstruction &inst);
+	void SLTU(const PackedInstruction &inst);
+	void SRA(const PackedInstruction &inst);
+	void SRAV(const PackedInstruction &inst);
+	void SRL(const PackedInstruction &inst);
+	void SRLV(const PackedInstruction &inst);
+	void Sub(const PackedInstruction &inst);
+	void SubU(const PackedInstruction &inst);
+	void SW(const PackedInstruction &inst);
+	void Xor(const PackedInstruction &inst);
+	void XorI(const PackedInstruction &inst);
 };
 }
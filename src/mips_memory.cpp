@@ -1,153 +1,153 @@
+#include <algorithm>
 #include <cstdint>
-#include <stdexcept>
-#include <string>
 #include <vector>
 
 #include "mips_memory.h"
 
 namespace MIPS {
-bool Memory::isValidStackIndex(uint32_t index)
+const uint32_t Memory::sZeroPage[PageWords] = {};
+
+Memory::Memory(const std::vector<uint32_t> &ram) : ram_(ram)
 {
-	return index < 0x4000;
+	uint32_t ramWords = static_cast<uint32_t>(
+		std::min<size_t>(ram_.size(), 1U << (SegmentShift - 2)));
+	uint32_t ramPages = (ramWords + PageWords - 1) / PageWords;
+	ramRead_.resize(ramPages);
+	ramWrite_.resize(ramPages);
+	for (uint32_t page = 0; page < ramPages; page++)
+		ramRead_[page] = ram_.data() + page * PageWords;
+
+	for (uint32_t page = 0; page < StackWords / PageWords; page++) {
+		stackRead_[page] = sZeroPage;
+		stackWrite_[page] = nullptr;
+	}
+
+	map(0x80, ramRead_.data(), ramWrite_.data(), ram_.data(), ramWords);
+	map(0xA0, ramRead_.data(), ramWrite_.data(), ram_.data(), ramWords);
+	map(0x81, stackRead_, stackWrite_, nullptr, StackWords);
+	map(0xA1, stackRead_, stackWrite_, nullptr, StackWords);
 }
 
-bool Memory::isValidRamIndex(uint32_t index)
+void Memory::map(uint32_t segment, const uint32_t **read, uint32_t **write,
+		 const uint32_t *shared, uint32_t words)
 {
-	return index < ram_.size();
+	segments_[segment] = Segment{read, write, shared, words};
 }
 
-uint32_t Memory::read(uint32_t vAddr)
+uint32_t *Memory::allocatePage()
 {
-	uint32_t seg = vAddr >> 24;
-	uint32_t off = vAddr & 0x00ffffff;
-	off /= 4;
-
-	if (seg == 0x80) {
-		if (isValidRamIndex(off)) {
-			return ram_[off];
-		} else {
-			throw std::runtime_error("RAM index out of bounds");
-		}
-	}
-
-	if (seg == 0x81) {
-		if (isValidStackIndex(off)) {
-			return stack_[off];
-		} else {
-			throw std::runtime_error("Stack index out of bounds");
-		}
-	}
+	if (arenaUsed_ == arena_.size() * ArenaChunkPages)
+		arena_.emplace_back(new uint32_t[ArenaChunkPages * PageWords]);
 
-	throw std::runtime_error("Unknown segment " + std::to_string(seg));
+	uint32_t *chunk = arena_[arenaUsed_ / ArenaChunkPages].get();
+	return chunk + (arenaUsed_++ % ArenaChunkPages) * PageWords;
 }
 
-void Memory::write(int vAddr, uint8_t val, int dataOff)
+Memory::Segment *Memory::translate(uint32_t vAddr, uint32_t &index)
 {
-	write(static_cast<uint32_t>(vAddr), val, dataOff);
+	Segment &segment = segments_[vAddr >> SegmentShift];
+	index = (vAddr & ((1U << SegmentShift) - 1)) / 4;
+	return index < segment.words ? &segment : nullptr;
 }
 
-void Memory::write(int vAddr, uint16_t val, int dataOff)
+uint32_t *Memory::writableWord(uint32_t vAddr)
 {
-	write(static_cast<uint32_t>(vAddr), val, dataOff);
+	uint32_t index;
+	Segment *segment = translate(vAddr, index);
+	if (!segment)
+		return nullptr;
+
+	uint32_t page = index / PageWords;
+	uint32_t *data = segment->write[page];
+	if (!data) {
+		// The last page of the dump may be cut short, the rest of the
+		// copy is never read since it is out of bounds
+		uint32_t words = std::min(PageWords,
+					  segment->words - page * PageWords);
+		data = allocatePage();
+		std::copy(segment->read[page], segment->read[page] + words,
+			  data);
+		segment->read[page] = data;
+		segment->write[page] = data;
+		copied_.emplace_back(segment, page);
+		if (segment->shared)
+			ramCopied_++;
+	}
+
+	return data + index % PageWords;
 }
 
-void Memory::write(int vAddr, uint32_t val)
+void Memory::reset()
 {
-	write(static_cast<uint32_t>(vAddr), val);
+	for (const auto &[segment, page] : copied_) {
+		const uint32_t *shared = segment->shared;
+		segment->read[page] = shared ? shared + page * PageWords
+					     : sZeroPage;
+		segment->write[page] = nullptr;
+	}
+
+	copied_.clear();
+	ramCopied_ = 0;
+	arenaUsed_ = 0;
 }
 
-void Memory::write(uint32_t vAddr, uint8_t val, int dataOff)
+bool Memory::read(uint32_t vAddr, uint32_t &value)
 {
-	uint32_t seg = vAddr >> 24;
-	uint32_t off = vAddr & 0x00ffffff;
-	off /= 4;
-
-	if (seg == 0x80) {
-		if (isValidRamIndex(off)) {
-			// int data = ram_[off];
-			// data &= (0xff << (24 - 8 * dataOff));
-			// data |= (val << (24 - 8 * dataOff));
-			// ram_[off] = data;
-			return;
-		} else {
-			throw std::runtime_error("RAM index out of bounds");
-		}
-	}
+	uint32_t index;
+	const Segment *segment = translate(vAddr, index);
+	if (!segment)
+		return false;
 
-	if (seg == 0x81) {
-		if (isValidStackIndex(off)) {
-			uint32_t data = stack_[off];
-			data &= (0xffU << (24 - 8 * dataOff));
-			data |= (static_cast<uint32_t>(val)
-				 << (24 - 8 * dataOff));
-			stack_[off] = data;
-			return;
-		} else {
-			throw std::runtime_error("Stack index out of bounds");
-		}
-	}
+	value = segment->read[index / PageWords][index % PageWords];
+	return true;
+}
 
-	throw std::runtime_error("Unknown segment " + std::to_string(seg));
+bool Memory::write(int vAddr, uint8_t val, int dataOff)
+{
+	return write(static_cast<uint32_t>(vAddr), val, dataOff);
 }
 
-void Memory::write(uint32_t vAddr, uint16_t val, int dataOff)
+bool Memory::write(int vAddr, uint16_t val, int dataOff)
 {
-	uint32_t seg = vAddr >> 24;
-	uint32_t off = vAddr & 0x00ffffff;
-	off /= 4;
-
-	if (seg == 0x80) {
-		if (isValidRamIndex(off)) {
-			// int data = ram_[off];
-			// data &= (0xff << (16 - 16 * dataOff));
-			// data |= (val << (16 - 16 * dataOff));
-			// ram_[off] = data;
-			return;
-		} else {
-			throw std::runtime_error("RAM index out of bounds");
-		}
-	}
+	return write(static_cast<uint32_t>(vAddr), val, dataOff);
+}
 
-	if (seg == 0x81) {
-		if (isValidStackIndex(off)) {
-			uint32_t data = stack_[off];
-			data &= (0xffU << (16 - 16 * dataOff));
-			data |= (static_cast<uint32_t>(val)
-				 << (16 - 16 * dataOff));
-			stack_[off] = data;
-			return;
-		} else {
-			throw std::runtime_error("Stack index out of bounds");
-		}
-	}
+bool Memory::write(int vAddr, uint32_t val)
+{
+	return write(static_cast<uint32_t>(vAddr), val);
+}
 
-	throw std::runtime_error("Unknown segment " + std::to_string(seg));
+bool Memory::write(uint32_t vAddr, uint8_t val, int dataOff)
+{
+	uint32_t *data = writableWord(vAddr);
+	if (!data)
+		return false;
+
+	int shift = 24 - 8 * dataOff;
+	*data &= ~(0xffU << shift);
+	*data |= static_cast<uint32_t>(val) << shift;
+	return true;
 }
 
-void Memory::write(uint32_t vAddr, uint32_t val)
+bool Memory::write(uint32_t vAddr, uint16_t val, int dataOff)
 {
-	uint32_t seg = vAddr >> 24;
-	uint32_t off = vAddr & 0x00ffffff;
-	off /= 4;
-
-	if (seg == 0x80) {
-		if (isValidRamIndex(off)) {
-			// ram_[off] = val;
-			return;
-		} else {
-			throw std::runtime_error("RAM index out of bounds");
-		}
-	}
+	uint32_t *data = writableWord(vAddr);
+	if (!data)
+		return false;
+
+	int shift = 16 - 16 * dataOff;
+	*data &= ~(0xffffU << shift);
+	*data |= static_cast<uint32_t>(val) << shift;
+	return true;
+}
 
-	if (seg == 0x81) {
-		if (isValidStackIndex(off)) {
-			stack_[off] = val;
-			return;
-		} else {
-			throw std::runtime_error("Stack index out of bounds");
-		}
-	}
+bool Memory::write(uint32_t vAddr, uint32_t val)
+{
+	uint32_t *data = writableWord(vAddr);
+	if (!data)
+		return false;
 
-	throw std::runtime_error("Unknown segment " + std::to_string(seg));
+	*data = val;
+	return true;
 }
 }
@@ -1,34 +1,98 @@
 #pragma once
 
 #include <cstdint>
-#include <stdexcept>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include <stdint.h>
 
 namespace MIPS {
+// Virtual memory as seen by interpreted code. Every 16 MB segment of the
+// 32-bit address space maps to a table of 4 KB host pages through
+// 'segments_', so an access is two table lookups, a bounds check and an
+// offset:
+//   0x80 KSEG0 and 0xA0 KSEG1 - the RAM dump
+//   0x81 KSEG0 and 0xA1 KSEG1 - a scratch stack, initially zero
+// The RAM dump and the zero page are shared and never written. The first
+// store to one of their pages copies it into a page from 'arena_', which
+// then replaces it for reads too, so many Memory instances can run against
+// one dump concurrently.
 class Memory {
 private:
+	static constexpr uint32_t PageWords = 0x400;
+	static constexpr uint32_t SegmentShift = 24;
+	static constexpr uint32_t SegmentCount = 1U << (32 - SegmentShift);
+	static constexpr uint32_t StackWords = 0x4000;
+	static constexpr uint32_t ArenaChunkPages = 16;
+
+	struct Segment {
+		// Host page per PageWords for reads
+		const uint32_t **read;
+		// Same page once it was copied, nullptr while it is shared
+		uint32_t **write;
+		// Contents before any store, nullptr for zeroes
+		const uint32_t *shared;
+		// 0 for unmapped segments so every access faults
+		uint32_t words;
+	};
+
+	static const uint32_t sZeroPage[PageWords];
+
 	uint32_t x;
 	const std::vector<uint32_t> &ram_;
-	std::vector<uint32_t> stack_;
 
-	bool isValidStackIndex(uint32_t index);
-	bool isValidRamIndex(uint32_t index);
+	std::vector<const uint32_t *> ramRead_;
+	std::vector<uint32_t *> ramWrite_;
+	const uint32_t *stackRead_[StackWords / PageWords];
+	uint32_t *stackWrite_[StackWords / PageWords];
+	Segment segments_[SegmentCount]{};
+
+	// Pages are handed out in order and all given back by 'reset'
+	std::vector<std::unique_ptr<uint32_t[]>> arena_;
+	size_t arenaUsed_{};
+	// Pages copied since the last reset, to point back at the shared ones
+	std::vector<std::pair<Segment *, uint32_t>> copied_;
+	// How many of them hold RAM rather than stack
+	uint32_t ramCopied_{};
+
+	void map(uint32_t segment, const uint32_t **read, uint32_t **write,
+		 const uint32_t *shared, uint32_t words);
+	uint32_t *allocatePage();
+	// Word index into the segment or nullptr if 'vAddr' is not mapped
+	Segment *translate(uint32_t vAddr, uint32_t &index);
+	// The word at 'vAddr' after copying its page if it was still shared
+	uint32_t *writableWord(uint32_t vAddr);
 
 public:
-	Memory(const std::vector<uint32_t> &ram) : ram_(ram), stack_(0x4000, 0)
+	Memory(const std::vector<uint32_t> &ram);
+
+	// 'segments_' points into the page tables of this instance
+	Memory(const Memory &) = delete;
+	Memory &operator=(const Memory &) = delete;
+
+	// Drops every store, the copied pages are kept for the next run
+	void reset();
+
+	// Whether a store went to RAM since the last reset, until then reads
+	// of RAM return the dump as it is
+	bool ramModified() const { return ramCopied_ != 0; }
+	// Whether 'vAddr' is in one of the RAM mirrors rather than the stack
+	bool mapsRAM(uint32_t vAddr) const
 	{
+		return segments_[vAddr >> SegmentShift].shared != nullptr;
 	}
 
-	uint32_t read(uint32_t vAddr);
+	// Accesses outside of the mapped segments return false and have no
+	// effect, nothing is thrown
+	bool read(uint32_t vAddr, uint32_t &value);
 
-	void write(int vAddr, uint8_t val, int dataOff);
-	void write(int vAddr, uint16_t val, int dataOff);
-	void write(int vAddr, uint32_t val);
+	bool write(int vAddr, uint8_t val, int dataOff);
+	bool write(int vAddr, uint16_t val, int dataOff);
+	bool write(int vAddr, uint32_t val);
 
-	void write(uint32_t vAddr, uint8_t val, int dataOff);
-	void write(uint32_t vAddr, uint16_t val, int dataOff);
-	void write(uint32_t vAddr, uint32_t val);
+	bool write(uint32_t vAddr, uint8_t val, int dataOff);
+	bool write(uint32_t vAddr, uint16_t val, int dataOff);
+	bool write(uint32_t vAddr, uint32_t val);
 };
 }
@@ -0,0 +1,62 @@
+#include "mips_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MIPS {
+size_t ChunksCount(size_t size, size_t chunkSize)
+{
+	return (size + chunkSize - 1) / chunkSize;
+}
+
+void ForEachChunk(size_t size, size_t chunkSize, bool serial,
+		  const ChunkFn &fn)
+{
+	size_t chunks = ChunksCount(size, chunkSize);
+	size_t workers = std::min<size_t>(std::thread::hardware_concurrency(),
+					  chunks);
+	if (serial || workers <= 1) {
+		for (size_t chunk = 0; chunk < chunks; ++chunk) {
+			size_t begin = chunk * chunkSize;
+			fn(chunk, begin, std::min(begin + chunkSize, size));
+		}
+		return;
+	}
+
+	std::atomic<size_t> next{0};
+	std::mutex errorMutex;
+	std::exception_ptr error;
+	auto work = [&]() {
+		for (size_t chunk = next++; chunk < chunks; chunk = next++) {
+			size_t begin = chunk * chunkSize;
+			try {
+				fn(chunk, begin,
+				   std::min(begin + chunkSize, size));
+			} catch (...) {
+				std::lock_guard<std::mutex> lck(errorMutex);
+				if (!error)
+					error = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	try {
+		for (size_t i = 1; i < workers; ++i)
+			threads.emplace_back(work);
+	} catch (...) {
+		// fewer workers only means less parallelism
+	}
+
+	work();
+	for (auto &thread : threads)
+		thread.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+}
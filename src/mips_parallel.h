@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <functional>
+
+namespace MIPS {
+
+// RAM words analyzed per chunk, small enough to balance 4 MB over many cores
+static const size_t AnalyzeChunkSize = 0x10000;
+
+using ChunkFn = std::function<void(size_t chunk, size_t begin, size_t end)>;
+
+size_t ChunksCount(size_t size, size_t chunkSize);
+
+// Splits [0, size) into chunks of 'chunkSize' and calls 'fn' once per chunk.
+// Chunks are spread over worker threads that live for the duration of the
+// call, the calling thread takes chunks as well. With 'serial' set every
+// chunk runs on the calling thread in order. Exceptions thrown by 'fn' are
+// rethrown after all workers are done.
+void ForEachChunk(size_t size, size_t chunkSize, bool serial,
+		  const ChunkFn &fn);
+}
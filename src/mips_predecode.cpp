@@ -0,0 +1,126 @@
+#include "mips_predecode.h"
+#include "mips_classify.h"
+#include "mips_parallel.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace MIPS {
+static_assert(AnalyzeChunkSize % 64 == 0,
+	      "chunks must not share bitmap words between threads");
+
+static int HighestBit(uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, bits);
+	return static_cast<int>(index);
+#else
+	return 63 - __builtin_clzll(bits);
+#endif
+}
+
+static int LowestBit(uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+int WordBitmap::findPrevious(int first, int last) const
+{
+	if (first < 0)
+		first = 0;
+	if (first >= last)
+		return -1;
+
+	// Bits at and above 'last' are masked off the first word looked at
+	int word = (last - 1) / 64;
+	uint64_t bits = words_[word] & (~static_cast<uint64_t>(0) >>
+					 (63 - (last - 1) % 64));
+	while (true) {
+		if (bits) {
+			int found = word * 64 + HighestBit(bits);
+			return found >= first ? found : -1;
+		}
+		if (word * 64 <= first)
+			return -1;
+
+		bits = words_[--word];
+	}
+}
+
+int WordBitmap::findNext(int first, int last) const
+{
+	if (first < 0)
+		first = 0;
+	if (first >= last)
+		return last;
+
+	int word = first / 64;
+	uint64_t bits = words_[word] &
+			(~static_cast<uint64_t>(0) << (first % 64));
+	while (true) {
+		if (bits) {
+			int found = word * 64 + LowestBit(bits);
+			return found < last ? found : last;
+		}
+		if ((word + 1) * 64 >= last)
+			return last;
+
+		bits = words_[++word];
+	}
+}
+
+DecodedRAM::DecodedRAM(const std::vector<uint32_t> &mem, bool serial)
+	: mem_(mem)
+{
+	data_.resize(mem.size());
+	for (WordBitmap &shape : shapes_)
+		shape.resize(mem.size());
+
+	// Chunks cover whole bitmap words so they never write the same one
+	std::vector<size_t> chunkData(
+		ChunksCount(mem.size(), AnalyzeChunkSize));
+	ForEachChunk(mem.size(), AnalyzeChunkSize, serial,
+		     [&](size_t chunk, size_t begin, size_t end) {
+			     uint64_t *masks[WordClassCount];
+			     for (int c = 0; c < WordClassCount; c++)
+				     masks[c] = shapes_[c].words() + begin / 64;
+			     ClassifyWords(mem.data() + begin, end - begin,
+					   masks);
+
+			     for (size_t base = begin; base < end; base += 64) {
+				     size_t count = std::min(end - base,
+							     size_t(64));
+				     decodeBlock(mem.data() + base, base, count,
+						 chunkData[chunk]);
+			     }
+		     });
+
+	codeCount_ = mem.size();
+	for (size_t words : chunkData)
+		codeCount_ -= words;
+}
+
+void DecodedRAM::decodeBlock(const uint32_t *words, size_t base, size_t count,
+			     size_t &dataCount)
+{
+	// Backwards so each word shifts its bit in at the bottom
+	uint64_t data = 0;
+	for (size_t i = count; i-- > 0;) {
+		bool isData = decodeCmd(words[i]) == CmdCount;
+		data = (data << 1) | isData;
+		dataCount += isData;
+	}
+
+	data_.assign(base / 64, data);
+}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "mips_classify.h"
+#include "mips_decompiler.h"
+#include "mips_types.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace MIPS {
+
+// One bit per RAM word, packed 64 to a word
+class WordBitmap {
+public:
+	void resize(size_t bits) { words_.assign((bits + 63) / 64, 0); }
+
+	void set(size_t bit)
+	{
+		words_[bit / 64] |= static_cast<uint64_t>(1) << (bit % 64);
+	}
+	// Replaces bits [64 * word, 64 * word + 64)
+	void assign(size_t word, uint64_t bits) { words_[word] = bits; }
+	// Bits [64 * i, 64 * i + 64) are in word 'i'
+	uint64_t *words() { return words_.data(); }
+	bool test(size_t bit) const
+	{
+		return (words_[bit / 64] >> (bit % 64)) & 1;
+	}
+
+	// Highest set bit in [first, last), -1 if there is none
+	int findPrevious(int first, int last) const;
+	// Lowest set bit in [first, last), 'last' if there is none
+	int findNext(int first, int last) const;
+
+private:
+	std::vector<uint64_t> words_;
+};
+
+// Bitmaps over all of RAM of the words the analysis looks for, built once by
+// 'ClassifyWords' and a sweep of the decoder. Later passes query these instead
+// of decoding the same regions again. Commands and operand fields are read
+// from the words themselves, arrays of them would cost more to fill than the
+// few lookups they would save.
+class DecodedRAM {
+public:
+	// Chunks of RAM are decoded in parallel unless 'serial' is set, the
+	// result is the same either way
+	explicit DecodedRAM(const std::vector<uint32_t> &mem,
+			    bool serial = false);
+
+	size_t size() const { return mem_.size(); }
+	// Words the decoder supports
+	size_t codeCount() const { return codeCount_; }
+
+	// CmdCount for words the decoder does not support, their fields are
+	// extracted all the same
+	uint32_t cmd(size_t i) const { return decodeCmd(mem_[i]); }
+	Register rs(size_t i) const
+	{
+		return static_cast<Register>((mem_[i] >> 21) & 0x1F);
+	}
+	Register rt(size_t i) const
+	{
+		return static_cast<Register>((mem_[i] >> 16) & 0x1F);
+	}
+	int16_t imm(size_t i) const { return static_cast<int16_t>(mem_[i]); }
+	// Word index a J or JAL goes to, the low 26 bits of the word
+	uint32_t jumpTarget(size_t i) const { return mem_[i] & 0x3FFFFFF; }
+
+	// Words the decoder does not support
+	const WordBitmap &data() const { return data_; }
+	// Words with the shape of 'wordClass', by 'ClassifyWords'
+	const WordBitmap &shape(WordClass wordClass) const
+	{
+		return shapes_[wordClass];
+	}
+	const WordBitmap &jals() const { return shape(WORD_CLASS_JAL); }
+	const WordBitmap &prologs() const { return shape(WORD_CLASS_PROLOG); }
+	const WordBitmap &returns() const { return shape(WORD_CLASS_RETURN); }
+
+private:
+	// Up to 64 words starting at 'base', a multiple of 64
+	void decodeBlock(const uint32_t *words, size_t base, size_t count,
+			 size_t &dataCount);
+
+	const std::vector<uint32_t> &mem_;
+
+	WordBitmap data_;
+	WordBitmap shapes_[WordClassCount];
+	size_t codeCount_;
+};
+}
@@ -0,0 +1,537 @@
+#include "mips_scanner.h"
+#include "mips_parallel.h"
+#include "mips_simd.h"
+#include "mips_types.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace MIPS {
+static bool MatchesWord(uint32_t data, const MaskPair &pattern)
+{
+	uint32_t maskedData = data & (~pattern.mask);
+	uint32_t leftoverData = data & pattern.mask;
+
+	return maskedData == pattern.val &&
+	       (pattern.mask == 0 || leftoverData != 0);
+}
+
+static bool MatchesWord(uint32_t data, uint32_t pattern)
+{
+	return data == pattern;
+}
+
+static MaskPair ToMaskPair(const MaskPair &pattern)
+{
+	return pattern;
+}
+
+static MaskPair ToMaskPair(uint32_t pattern)
+{
+	return {pattern, 0};
+}
+
+template<typename T>
+static bool MatchesAt(const uint32_t *data, const T *patternToFind,
+		      size_t patternToFindSize)
+{
+	for (size_t j = 0; j < patternToFindSize; ++j) {
+		if (!MatchesWord(data[j], patternToFind[j]))
+			return false;
+	}
+
+	return true;
+}
+
+template<typename T>
+static std::vector<int>
+IndicesOfScalar(const std::vector<uint32_t> &arrayToSearchThrough,
+		const T *patternToFind, size_t patternToFindSize)
+{
+	std::vector<int> ret;
+
+	if (patternToFindSize > arrayToSearchThrough.size())
+		return ret;
+
+	for (size_t i = 0; i <= arrayToSearchThrough.size() - patternToFindSize;
+	     ++i) {
+		if (MatchesAt(&arrayToSearchThrough[i], patternToFind,
+			      patternToFindSize)) {
+			ret.push_back(static_cast<int>(i));
+		}
+	}
+
+	return ret;
+}
+
+// Distinct first words of all signatures the matcher tests with a vector
+// compare before dispatching, with more of them the dispatch table alone is
+// faster
+static const size_t MaxPrefilterWords = 8;
+
+#ifdef MIPS_SCANNER_X86
+static bool MatchesAny(uint32_t data, const std::vector<MaskPair> &words)
+{
+	return std::any_of(words.begin(), words.end(),
+			   [&](const MaskPair &word) {
+				   return MatchesWord(data, word);
+			   });
+}
+
+static unsigned CountTrailingZeros(uint32_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return static_cast<unsigned>(index);
+#else
+	return static_cast<unsigned>(__builtin_ctz(bits));
+#endif
+}
+
+// 'hits' has a bit set for every position starting at 'base' whose first
+// word matched, the rest of the pattern is checked here
+template<typename T>
+static void VerifyHits(uint32_t hits, size_t base, const uint32_t *data,
+		       const T *patternToFind, size_t patternToFindSize,
+		       std::vector<int> &ret)
+{
+	while (hits) {
+		size_t i = base + CountTrailingZeros(hits);
+		hits &= hits - 1;
+		if (MatchesAt(data + i + 1, patternToFind + 1,
+			      patternToFindSize - 1))
+			ret.push_back(static_cast<int>(i));
+	}
+}
+
+// First pattern word in every lane
+struct FirstWordSSE2 {
+	__m128i val;
+	__m128i mask;
+	__m128i notMask;
+	__m128i leftoverRequired;
+};
+
+static FirstWordSSE2 BroadcastSSE2(const MaskPair &first)
+{
+	return {_mm_set1_epi32(static_cast<int>(first.val)),
+		_mm_set1_epi32(static_cast<int>(first.mask)),
+		_mm_set1_epi32(static_cast<int>(~first.mask)),
+		_mm_set1_epi32(first.mask != 0 ? -1 : 0)};
+}
+
+// Bit k is set if word k of the 16 at 'data' matches the first word
+static uint32_t HitsSSE2(const uint32_t *data, const FirstWordSSE2 &first)
+{
+	const __m128i zero = _mm_setzero_si128();
+	uint32_t hits = 0;
+	for (int k = 0; k < 4; ++k) {
+		__m128i words = _mm_loadu_si128(
+			reinterpret_cast<const __m128i *>(data + 4 * k));
+		__m128i hit = _mm_cmpeq_epi32(
+			_mm_and_si128(words, first.notMask), first.val);
+		__m128i noLeftover = _mm_and_si128(
+			_mm_cmpeq_epi32(_mm_and_si128(words, first.mask), zero),
+			first.leftoverRequired);
+		hit = _mm_andnot_si128(noLeftover, hit);
+		hits |= static_cast<uint32_t>(
+				_mm_movemask_ps(_mm_castsi128_ps(hit)))
+			<< (4 * k);
+	}
+	return hits;
+}
+
+struct FirstWordAVX2 {
+	__m256i val;
+	__m256i mask;
+	__m256i notMask;
+	__m256i leftoverRequired;
+};
+
+MIPS_TARGET_AVX2 static void BroadcastAVX2(const MaskPair &first,
+					   FirstWordAVX2 &ret)
+{
+	ret.val = _mm256_set1_epi32(static_cast<int>(first.val));
+	ret.mask = _mm256_set1_epi32(static_cast<int>(first.mask));
+	ret.notMask = _mm256_set1_epi32(static_cast<int>(~first.mask));
+	ret.leftoverRequired = _mm256_set1_epi32(first.mask != 0 ? -1 : 0);
+}
+
+MIPS_TARGET_AVX2 static uint32_t HitsAVX2(const uint32_t *data,
+					  const FirstWordAVX2 &first)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	uint32_t hits = 0;
+	for (int k = 0; k < 2; ++k) {
+		__m256i words = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i *>(data + 8 * k));
+		__m256i hit = _mm256_cmpeq_epi32(
+			_mm256_and_si256(words, first.notMask), first.val);
+		__m256i noLeftover = _mm256_and_si256(
+			_mm256_cmpeq_epi32(_mm256_and_si256(words, first.mask),
+					   zero),
+			first.leftoverRequired);
+		hit = _mm256_andnot_si256(noLeftover, hit);
+		hits |= static_cast<uint32_t>(_mm256_movemask_ps(
+				_mm256_castsi256_ps(hit)))
+			<< (8 * k);
+	}
+	return hits;
+}
+
+template<typename T>
+static std::vector<int>
+IndicesOfSSE2(const std::vector<uint32_t> &arrayToSearchThrough,
+	      const T *patternToFind, size_t patternToFindSize)
+{
+	std::vector<int> ret;
+
+	const uint32_t *data = arrayToSearchThrough.data();
+	size_t end = arrayToSearchThrough.size() - patternToFindSize + 1;
+	FirstWordSSE2 first = BroadcastSSE2(ToMaskPair(patternToFind[0]));
+
+	size_t i = 0;
+	for (; i + 16 <= end; i += 16)
+		VerifyHits(HitsSSE2(data + i, first), i, data, patternToFind,
+			   patternToFindSize, ret);
+
+	for (; i < end; ++i) {
+		if (MatchesAt(data + i, patternToFind, patternToFindSize))
+			ret.push_back(static_cast<int>(i));
+	}
+
+	return ret;
+}
+
+template<typename T>
+MIPS_TARGET_AVX2 static std::vector<int>
+IndicesOfAVX2(const std::vector<uint32_t> &arrayToSearchThrough,
+	      const T *patternToFind, size_t patternToFindSize)
+{
+	std::vector<int> ret;
+
+	const uint32_t *data = arrayToSearchThrough.data();
+	size_t end = arrayToSearchThrough.size() - patternToFindSize + 1;
+	FirstWordAVX2 first;
+	BroadcastAVX2(ToMaskPair(patternToFind[0]), first);
+
+	size_t i = 0;
+	for (; i + 16 <= end; i += 16)
+		VerifyHits(HitsAVX2(data + i, first), i, data, patternToFind,
+			   patternToFindSize, ret);
+
+	for (; i < end; ++i) {
+		if (MatchesAt(data + i, patternToFind, patternToFindSize))
+			ret.push_back(static_cast<int>(i));
+	}
+
+	return ret;
+}
+
+// Positions in [begin, end) whose word matches any of 'firsts', ascending
+static void FirstWordHitsSSE2(const uint32_t *data, size_t begin, size_t end,
+			      const std::vector<MaskPair> &firsts,
+			      std::vector<uint32_t> &hits)
+{
+	FirstWordSSE2 broadcast[MaxPrefilterWords];
+	for (size_t f = 0; f < firsts.size(); ++f)
+		broadcast[f] = BroadcastSSE2(firsts[f]);
+
+	size_t i = begin;
+	for (; i + 16 <= end; i += 16) {
+		uint32_t bits = 0;
+		for (size_t f = 0; f < firsts.size(); ++f)
+			bits |= HitsSSE2(data + i, broadcast[f]);
+		for (; bits; bits &= bits - 1)
+			hits.push_back(static_cast<uint32_t>(
+				i + CountTrailingZeros(bits)));
+	}
+
+	for (; i < end; ++i) {
+		if (MatchesAny(data[i], firsts))
+			hits.push_back(static_cast<uint32_t>(i));
+	}
+}
+
+MIPS_TARGET_AVX2 static void
+FirstWordHitsAVX2(const uint32_t *data, size_t begin, size_t end,
+		  const std::vector<MaskPair> &firsts,
+		  std::vector<uint32_t> &hits)
+{
+	FirstWordAVX2 broadcast[MaxPrefilterWords];
+	for (size_t f = 0; f < firsts.size(); ++f)
+		BroadcastAVX2(firsts[f], broadcast[f]);
+
+	size_t i = begin;
+	for (; i + 16 <= end; i += 16) {
+		uint32_t bits = 0;
+		for (size_t f = 0; f < firsts.size(); ++f)
+			bits |= HitsAVX2(data + i, broadcast[f]);
+		for (; bits; bits &= bits - 1)
+			hits.push_back(static_cast<uint32_t>(
+				i + CountTrailingZeros(bits)));
+	}
+
+	for (; i < end; ++i) {
+		if (MatchesAny(data[i], firsts))
+			hits.push_back(static_cast<uint32_t>(i));
+	}
+}
+#endif
+
+static ScanKernel DetectScanKernel()
+{
+#ifdef MIPS_SCANNER_X86
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7) {
+		__cpuid(info, 1);
+		bool osxsave = info[2] & (1 << 27);
+		bool avx = info[2] & (1 << 28);
+		__cpuidex(info, 7, 0);
+		bool avx2 = info[1] & (1 << 5);
+		if (osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+			return SCAN_KERNEL_AVX2;
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SCAN_KERNEL_AVX2;
+#endif
+	return SCAN_KERNEL_SSE2;
+#else
+	return SCAN_KERNEL_SCALAR;
+#endif
+}
+
+ScanKernel BestScanKernel()
+{
+	static const ScanKernel kernel = DetectScanKernel();
+	return kernel;
+}
+
+template<typename T>
+static std::vector<int>
+IndicesOfImpl(const std::vector<uint32_t> &arrayToSearchThrough,
+	      const T *patternToFind, size_t patternToFindSize,
+	      ScanKernel kernel)
+{
+	if (kernel > BestScanKernel())
+		kernel = BestScanKernel();
+
+	// vector kernels need the first word to test against
+	if (patternToFindSize == 0 ||
+	    patternToFindSize > arrayToSearchThrough.size())
+		kernel = SCAN_KERNEL_SCALAR;
+
+#ifdef MIPS_SCANNER_X86
+	if (kernel == SCAN_KERNEL_AVX2)
+		return IndicesOfAVX2(arrayToSearchThrough, patternToFind,
+				     patternToFindSize);
+	if (kernel == SCAN_KERNEL_SSE2)
+		return IndicesOfSSE2(arrayToSearchThrough, patternToFind,
+				     patternToFindSize);
+#endif
+
+	return IndicesOfScalar(arrayToSearchThrough, patternToFind,
+			       patternToFindSize);
+}
+
+std::vector<int> IndicesOf(const std::vector<uint32_t> &arrayToSearchThrough,
+			   const MaskPair *patternToFind,
+			   size_t patternToFindSize, ScanKernel kernel)
+{
+	return IndicesOfImpl(arrayToSearchThrough, patternToFind,
+			     patternToFindSize, kernel);
+}
+
+std::vector<int> IndicesOf(const std::vector<uint32_t> &arrayToSearchThrough,
+			   const uint32_t *patternToFind,
+			   size_t patternToFindSize, ScanKernel kernel)
+{
+	return IndicesOfImpl(arrayToSearchThrough, patternToFind,
+			     patternToFindSize, kernel);
+}
+
+// Opcodes below 64, SPECIAL functions are 64 and above
+static const uint32_t DispatchKeysCount = 128;
+// Keys of a word and the one after it
+static const uint32_t DispatchPairsCount =
+	DispatchKeysCount * DispatchKeysCount;
+
+static uint32_t DispatchKey(uint32_t word)
+{
+	uint32_t op = word >> 26;
+	return op != OP_SPECIAL ? op : 64 + (word & 0x3F);
+}
+
+// Checks whether a word with the given dispatch key can match 'head'
+static bool IsDispatchKeyCompatible(uint32_t key, const MaskPair &head)
+{
+	// SPECIAL words are always dispatched on their function
+	if (key == OP_SPECIAL)
+		return false;
+
+	uint32_t keyBits = key < 64 ? key << 26 : key - 64;
+	uint32_t keyMask = key < 64 ? 0xFC000000 : 0xFC00003F;
+	return 0 == ((keyBits ^ head.val) & keyMask & ~head.mask);
+}
+
+size_t SignatureMatcher::add(const MaskPair *patternToFind,
+			     size_t patternToFindSize)
+{
+	if (patternToFindSize == 0)
+		throw std::invalid_argument("Empty signature");
+
+	signatures_.push_back({static_cast<uint32_t>(words_.size()),
+			       static_cast<uint32_t>(patternToFindSize)});
+	words_.insert(words_.end(), patternToFind,
+		      patternToFind + patternToFindSize);
+	compile();
+	return signatures_.size() - 1;
+}
+
+size_t SignatureMatcher::add(const uint32_t *patternToFind,
+			     size_t patternToFindSize)
+{
+	std::vector<MaskPair> pattern;
+	pattern.reserve(patternToFindSize);
+	for (size_t j = 0; j < patternToFindSize; ++j)
+		pattern.push_back(ToMaskPair(patternToFind[j]));
+
+	return add(pattern.data(), pattern.size());
+}
+
+static std::vector<uint32_t> CompatibleDispatchKeys(const MaskPair &word)
+{
+	std::vector<uint32_t> keys;
+	for (uint32_t key = 0; key < DispatchKeysCount; ++key) {
+		if (IsDispatchKeyCompatible(key, word))
+			keys.push_back(key);
+	}
+	return keys;
+}
+
+void SignatureMatcher::compile()
+{
+	// Only the pairs of the signature added last are new, single word
+	// signatures may be followed by anything
+	uint32_t id = static_cast<uint32_t>(signatures_.size() - 1);
+	const Signature &signature = signatures_[id];
+	const MaskPair &head = words_[signature.first];
+	if (std::none_of(firsts_.begin(), firsts_.end(),
+			 [&](const MaskPair &word) {
+				 return word.val == head.val &&
+					word.mask == head.mask;
+			 }))
+		firsts_.push_back(head);
+
+	std::vector<uint32_t> firstKeys =
+		CompatibleDispatchKeys(words_[signature.first]);
+	std::vector<uint32_t> secondKeys(DispatchKeysCount);
+	if (signature.size > 1)
+		secondKeys =
+			CompatibleDispatchKeys(words_[signature.first + 1]);
+	else
+		std::iota(secondKeys.begin(), secondKeys.end(), 0);
+
+	// Signatures of a pair stay in the order they were added
+	for (uint32_t first : firstKeys) {
+		for (uint32_t second : secondKeys) {
+			std::pair<uint32_t, uint32_t> pair = {
+				first * DispatchKeysCount + second, id};
+			pairs_.insert(std::upper_bound(pairs_.begin(),
+						       pairs_.end(), pair),
+				      pair);
+		}
+	}
+
+	heads_.assign(DispatchPairsCount + 1, 0);
+	entries_.clear();
+	for (const auto &pair : pairs_) {
+		heads_[pair.first + 1]++;
+		entries_.push_back(pair.second);
+	}
+	std::partial_sum(heads_.begin(), heads_.end(), heads_.begin());
+}
+
+void SignatureMatcher::matchAt(const uint32_t *data, size_t size, size_t i,
+			       std::vector<std::vector<int>> &ret) const
+{
+	// Only single word signatures fit at the last word, they are
+	// dispatched on any second key
+	uint32_t next = i + 1 < size ? DispatchKey(data[i + 1]) : 0;
+	uint32_t key = DispatchKey(data[i]) * DispatchKeysCount + next;
+	for (uint32_t e = heads_[key]; e < heads_[key + 1]; ++e) {
+		uint32_t id = entries_[e];
+		const Signature &signature = signatures_[id];
+		if (signature.size > size - i)
+			continue;
+
+		if (MatchesAt(data + i, &words_[signature.first],
+			      signature.size))
+			ret[id].push_back(static_cast<int>(i));
+	}
+}
+
+void SignatureMatcher::matchRange(
+	const std::vector<uint32_t> &arrayToSearchThrough, size_t begin,
+	size_t end, ScanKernel kernel, std::vector<std::vector<int>> &ret) const
+{
+	ret.resize(signatures_.size());
+
+	// signatures starting in the range may extend past its end
+	const uint32_t *data = arrayToSearchThrough.data();
+	size_t size = arrayToSearchThrough.size();
+#ifdef MIPS_SCANNER_X86
+	// With few distinct first words the vector compare skips most of the
+	// words before they reach the dispatch table
+	if (kernel != SCAN_KERNEL_SCALAR && !firsts_.empty() &&
+	    firsts_.size() <= MaxPrefilterWords) {
+		std::vector<uint32_t> hits;
+		if (kernel == SCAN_KERNEL_AVX2)
+			FirstWordHitsAVX2(data, begin, end, firsts_, hits);
+		else
+			FirstWordHitsSSE2(data, begin, end, firsts_, hits);
+		for (uint32_t i : hits)
+			matchAt(data, size, i, ret);
+		return;
+	}
+#else
+	(void)kernel;
+#endif
+	for (size_t i = begin; i < end; ++i)
+		matchAt(data, size, i, ret);
+}
+
+std::vector<std::vector<int>>
+SignatureMatcher::match(const std::vector<uint32_t> &arrayToSearchThrough,
+			bool serial, ScanKernel kernel) const
+{
+	if (kernel > BestScanKernel())
+		kernel = BestScanKernel();
+
+	size_t size = arrayToSearchThrough.size();
+	std::vector<std::vector<std::vector<int>>> chunkMatches(
+		ChunksCount(size, AnalyzeChunkSize));
+	ForEachChunk(size, AnalyzeChunkSize, serial,
+		     [&](size_t chunk, size_t begin, size_t end) {
+			     matchRange(arrayToSearchThrough, begin, end,
+					kernel, chunkMatches[chunk]);
+		     });
+
+	std::vector<std::vector<int>> ret(signatures_.size());
+	for (const auto &matches : chunkMatches) {
+		for (size_t id = 0; id < matches.size(); ++id) {
+			ret[id].insert(ret[id].end(), matches[id].begin(),
+				       matches[id].end());
+		}
+	}
+
+	return ret;
+}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace MIPS {
+
+struct MaskPair {
+	uint32_t val;
+	uint32_t mask;
+
+	constexpr MaskPair(uint32_t value, uint32_t wildcards)
+		: val(value), mask(wildcards)
+	{
+	}
+
+	std::string toString() const
+	{
+		std::ostringstream stream;
+		stream << std::hex << std::showbase << "0x" << val << ", 0x"
+		       << mask;
+		return stream.str();
+	}
+};
+
+enum ScanKernel {
+	SCAN_KERNEL_SCALAR,
+	SCAN_KERNEL_SSE2,
+	SCAN_KERNEL_AVX2,
+};
+
+// The widest kernel the running CPU supports, detected once
+ScanKernel BestScanKernel();
+
+// Returns every index the pattern matches at, in ascending order.
+// A MaskPair word matches when 'data & ~mask' equals 'val' and, if 'mask' is
+// not zero, 'data & mask' is not zero either.
+// Vector kernels test the first pattern word for 16 positions at once and
+// only verify the rest of the pattern on hits. Kernels the CPU does not
+// support fall back to the best supported one, SCAN_KERNEL_SCALAR is the
+// reference implementation.
+std::vector<int> IndicesOf(const std::vector<uint32_t> &arrayToSearchThrough,
+			   const MaskPair *patternToFind,
+			   size_t patternToFindSize,
+			   ScanKernel kernel = BestScanKernel());
+std::vector<int> IndicesOf(const std::vector<uint32_t> &arrayToSearchThrough,
+			   const uint32_t *patternToFind,
+			   size_t patternToFindSize,
+			   ScanKernel kernel = BestScanKernel());
+
+// Matches a whole set of signatures in a single sweep over RAM. Signatures are
+// dispatched on the opcodes of their first two words, and on the function for
+// SPECIAL opcodes, so every RAM word is only checked against the few
+// signatures that may start with it and the word after it. Adding signatures
+// with other opcodes does not slow down matching the others.
+class SignatureMatcher {
+public:
+	// Returns the id of the signature, ids are assigned sequentially
+	size_t add(const MaskPair *patternToFind, size_t patternToFindSize);
+	size_t add(const uint32_t *patternToFind, size_t patternToFindSize);
+
+	size_t size() const { return signatures_.size(); }
+
+	// Returns the matched indices of every signature in ascending order,
+	// indexed by signature id. Chunks of RAM are matched in parallel
+	// unless 'serial' is set, signatures that straddle chunk boundaries
+	// are still found and the result is the same either way. Vector
+	// kernels find the words a signature may start with first when the
+	// signatures have few distinct first words, the result is the same
+	// with every kernel.
+	std::vector<std::vector<int>>
+	match(const std::vector<uint32_t> &arrayToSearchThrough,
+	      bool serial = false, ScanKernel kernel = BestScanKernel()) const;
+
+private:
+	struct Signature {
+		uint32_t first;
+		uint32_t size;
+	};
+
+	void compile();
+	void matchAt(const uint32_t *data, size_t size, size_t i,
+		     std::vector<std::vector<int>> &ret) const;
+	void matchRange(const std::vector<uint32_t> &arrayToSearchThrough,
+			size_t begin, size_t end, ScanKernel kernel,
+			std::vector<std::vector<int>> &ret) const;
+
+	std::vector<MaskPair> words_;
+	std::vector<Signature> signatures_;
+	// Distinct first words of the signatures in the order they were added
+	std::vector<MaskPair> firsts_;
+
+	// CSR table from a pair of dispatch keys to the signatures they may
+	// start, built from every pair and signature id in ascending order
+	std::vector<std::pair<uint32_t, uint32_t>> pairs_;
+	std::vector<uint32_t> heads_;
+	std::vector<uint32_t> entries_;
+};
+}
@@ -0,0 +1,437 @@
+#include "mips_signatures.h"
+#include "mips_assembler.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace MIPS {
+
+// Cache ops of the D-cache loops
+static constexpr int DCache = CACHE_D;
+static constexpr int DIndexLoadData = CACHE_D | CACHE_IIndexLoadData;
+static constexpr int DCacheBarrier = CACHE_D | CACHE_CacheBarrier;
+static constexpr int DHitInvalidate = CACHE_D | CACHE_IHitInvalidate;
+
+static constexpr MaskPair OsGetCount[] = {
+	Asm(CMD_MFC0).rt(REG_V0).cop0(COP0_Count),
+	Asm(CMD_JR).rs(REG_RA),
+	Asm(CMD_NOP),
+};
+
+static constexpr MaskPair OsDisableInt[] = {
+	Asm(CMD_MFC0).cop0(COP0_Status),
+	Asm(CMD_ADDIU).rs(REG_R0).imm(0xFFFE),
+	Asm(CMD_AND),
+	Asm(CMD_MTC0).cop0(COP0_Status),
+	Asm(CMD_ANDI).rt(REG_V0).imm(0x0001),
+};
+
+static constexpr MaskPair OsRestoreInt[] = {
+	Asm(CMD_MFC0).cop0(COP0_Status),
+	Asm(CMD_OR).rt(REG_A0),
+	Asm(CMD_MTC0).cop0(COP0_Status),
+	Asm(CMD_NOP),
+	Asm(CMD_NOP),
+	Asm(CMD_JR).rs(REG_RA),
+	Asm(CMD_NOP),
+};
+
+static constexpr MaskPair OsWritebackDCache[] = {
+	Asm(CMD_SUBU),
+	Asm(CMD_CACHE).cache(DIndexLoadData).off(0x0000),
+	Asm(CMD_SLTU),
+	Asm(CMD_BNE).rt(REG_R0).off(-0xc),
+	Asm(CMD_ADDIU).imm(0x0010),
+	Asm(CMD_JR).rs(REG_RA),
+	Asm(CMD_NOP),
+	Asm(CMD_LUI).imm(0x8000),
+	Asm(CMD_ADDU),
+	Asm(CMD_ADDIU).imm(0xFFF0),
+	Asm(CMD_CACHE).cache(DCache).off(0x0000),
+	Asm(CMD_SLTU),
+	Asm(CMD_BNE).rt(REG_R0).off(-0xc),
+	Asm(CMD_ADDIU).imm(0x0010),
+	Asm(CMD_JR).rs(REG_RA),
+	Asm(CMD_NOP),
+};
+
+static constexpr MaskPair OsInvalDCache[] = {
+	Asm(CMD_SUBU),
+	Asm(CMD_CACHE).cache(DCacheBarrier).off(0x0000),
+	Asm(CMD_SLTU),
+	Asm(CMD_BEQ).rt(REG_R0).off(0x38),
+	Asm(CMD_NOP),
+	Asm(CMD_ADDIU).imm(0x0010),
+	Asm(CMD_ANDI).imm(0x000F),
+	Asm(CMD_BEQ).rt(REG_R0).off(0x18),
+	Asm(CMD_NOP),
+	Asm(CMD_SUBU),
+	Asm(CMD_CACHE).cache(DCacheBarrier).off(0x0040),
+	Asm(CMD_SLTU),
+	Asm(CMD_BNE).rt(REG_R0).off(0x14),
+	Asm(CMD_NOP),
+	Asm(CMD_CACHE).cache(DHitInvalidate).off(0x0000),
+	Asm(CMD_SLTU),
+	Asm(CMD_BNE).rt(REG_R0).off(-0xc),
+	Asm(CMD_ADDIU).imm(0x0010),
+	Asm(CMD_JR).rs(REG_RA),
+	Asm(CMD_NOP),
+	Asm(CMD_LUI).imm(0x8000),
+	Asm(CMD_ADDU),
+	Asm(CMD_ADDIU).imm(0xFFF0),
+	Asm(CMD_CACHE).cache(DCache).off(0x0000),
+	Asm(CMD_SLTU),
+	Asm(CMD_BNE).rt(REG_R0).off(-0xc),
+	Asm(CMD_ADDIU).imm(0x0010),
+	Asm(CMD_JR).rs(REG_RA),
+	Asm(CMD_NOP),
+};
+
+static constexpr MaskPair GPRSetup[] = {
+	Asm(CMD_LUI).rt(REG_GP),
+	Asm(CMD_JR).rs(REG_RA),
+	Asm(CMD_ADDIU).rt(REG_GP).rs(REG_GP),
+};
+
+// The tables as they were written by hand, 'val, mask' per word. Changing
+// the assembler must not change a single bit of them.
+static constexpr uint32_t OsGetCountHex[] = {
+	0x40024800, 0x00000000, // MFC0     V0, Count
+	0x03E00008, 0x00000000, // JR       RA
+	0x00000000, 0x00000000, // NOP
+};
+static_assert(Assembles(OsGetCount, OsGetCountHex), "osGetCount");
+
+static constexpr uint32_t OsDisableIntHex[] = {
+	0x40006000, 0x001F0000, // MFC0     __, Status
+	0x2400FFFE, 0x001F0000, // ADDIU    __, R0, 0xFFFE
+	0x00000024, 0x03FFF800, // AND      __, __, __
+	0x40806000, 0x001F0000, // MTC0     __, Status
+	0x30020001, 0x03E00000, // ANDI     V0, __, 0x0001
+};
+static_assert(Assembles(OsDisableInt, OsDisableIntHex), "__osDisableInt");
+
+static constexpr uint32_t OsRestoreIntHex[] = {
+	0x40006000, 0x001F0000, // MFC0     __, Status
+	0x00040025, 0x03E0F800, // OR       __, __, A0
+	0x40806000, 0x001F0000, // MTC0     __, Status
+	0x00000000, 0x00000000, // NOP
+	0x00000000, 0x00000000, // NOP
+	0x03E00008, 0x00000000, // JR       RA
+	0x00000000, 0x00000000, // NOP
+};
+static_assert(Assembles(OsRestoreInt, OsRestoreIntHex), "__osRestoreInt");
+
+static constexpr uint32_t OsWritebackDCacheHex[] = {
+	0x00000023, 0x03FFF800, // SUBU     __, __, __
+	0xBC190000, 0x03E00000, // CACHE    (D, IIndexLoadData), __, 0x0000
+	0x0000002B, 0x03FFF800, // SLTU     __, __, __
+	0x1400FFFD, 0x03E00000, // BNE      R0, 0xFFFFFFF4(__)
+	0x24000010, 0x03FF0000, // ADDIU    __, __, 0x0010
+	0x03E00008, 0x00000000, // JR       RA
+	0x00000000, 0x00000000, // NOP
+	0x3C008000, 0x001F0000, // LUI      __, 0x8000
+	0x00000021, 0x03FFF800, // ADDU     __, __, __
+	0x2400FFF0, 0x03FF0000, // ADDIU    __, __, 0xFFF0
+	0xBC010000, 0x03E00000, // CACHE    (D), __, 0x0000
+	0x0000002B, 0x03FFF800, // SLTU     __, __, __
+	0x1400FFFD, 0x03E00000, // BNE      R0, 0xFFFFFFF4(__)
+	0x24000010, 0x03FF0000, // ADDIU    __, __, 0x0010
+	0x03E00008, 0x00000000, // JR       RA
+	0x00000000, 0x00000000, // NOP
+};
+static_assert(Assembles(OsWritebackDCache, OsWritebackDCacheHex),
+	      "osWritebackDCache");
+
+static constexpr uint32_t OsInvalDCacheHex[] = {
+	0x00000023, 0x03FFF800, // SUBU     __, __, __
+	0xBC150000, 0x03E00000, // CACHE    (D, CacheBarrier), __, 0x0000
+	0x0000002B, 0x03FFF800, // SLTU     __, __, __
+	0x1000000E, 0x03E00000, // BEQ      R0, 0x38(__)
+	0x00000000, 0x00000000, // NOP
+	0x24000010, 0x03FF0000, // ADDIU    __, __, 0x0010
+	0x3000000F, 0x03FF0000, // ANDI     __, __, 0x000F
+	0x10000006, 0x03E00000, // BEQ      R0, 0x18(__)
+	0x00000000, 0x00000000, // NOP
+	0x00000023, 0x03FFF800, // SUBU     __, __, __
+	0xBC150010, 0x03E00000, // CACHE    (D, CacheBarrier), __, 0x0040
+	0x0000002B, 0x03FFF800, // SLTU     __, __, __
+	0x14000005, 0x03E00000, // BNE      R0, 0x14(__)
+	0x00000000, 0x00000000, // NOP
+	0xBC110000, 0x03E00000, // CACHE    (D, IHitInvalidate), __, 0x0000
+	0x0000002B, 0x03FFF800, // SLTU     __, __, __
+	0x1400FFFD, 0x03E00000, // BNE      R0, 0xFFFFFFF4(__)
+	0x24000010, 0x03FF0000, // ADDIU    __, __, 0x0010
+	0x03E00008, 0x00000000, // JR       RA
+	0x00000000, 0x00000000, // NOP
+	0x3C008000, 0x001F0000, // LUI      __, 0x8000
+	0x00000021, 0x03FFF800, // ADDU     __, __, __
+	0x2400FFF0, 0x03FF0000, // ADDIU    __, __, 0xFFF0
+	0xBC010000, 0x03E00000, // CACHE    (D), __, 0x0000
+	0x0000002B, 0x03FFF800, // SLTU     __, __, __
+	0x1400FFFD, 0x03E00000, // BNE      R0, 0xFFFFFFF4(__)
+	0x24000010, 0x03FF0000, // ADDIU    __, __, 0x0010
+	0x03E00008, 0x00000000, // JR       RA
+	0x00000000, 0x00000000, // NOP
+};
+static_assert(Assembles(OsInvalDCache, OsInvalDCacheHex), "osInvalDCache");
+
+static constexpr uint32_t GPRSetupHex[] = {
+	0x3c1c0000, 0x0000ffff, // LUI      GP, ____
+	0x03E00008, 0x00000000, // JR       RA
+	0x279c0000, 0x0000ffff, // ADDIU    GP, GP, ____
+};
+static_assert(Assembles(GPRSetup, GPRSetupHex), "gp-setup");
+
+static const char *const sTargetNames[SignatureTargetCount] = {
+	"osGetCount",        "__osDisableInt", "__osRestoreInt",
+	"osWritebackDCache", "osInvalDCache",  "gp-setup",
+};
+
+// Oldest revision the offsets below were taken from
+static const int BuiltInPrologWords = 4;
+
+template<size_t N>
+static std::vector<MaskPair> Words(const MaskPair (&words)[N])
+{
+	return std::vector<MaskPair>(words, words + N);
+}
+
+const SignatureDatabase &SignatureDatabase::builtIn()
+{
+	static const SignatureDatabase sBuiltIn = [] {
+		SignatureDatabase database;
+		database.add(TARGET_OS_GET_COUNT, Words(OsGetCount), {0});
+		// Newer revisions check the global interrupt mask first
+		database.add(TARGET_OS_DISABLE_INT, Words(OsDisableInt),
+			     {0, -4});
+		database.add(TARGET_OS_RESTORE_INT, Words(OsRestoreInt), {0});
+		database.add(TARGET_OS_WRITEBACK_DCACHE,
+			     Words(OsWritebackDCache), {-0xd});
+		// Some builds have an extra NOP before the signature
+		database.add(TARGET_OS_INVAL_DCACHE, Words(OsInvalDCache),
+			     {-0xe, -0xf});
+		database.add(TARGET_GP_SETUP, Words(GPRSetup), {0});
+		database.revisions_.push_back("built-in");
+		database.prologWords_ = BuiltInPrologWords;
+		return database;
+	}();
+	return sBuiltIn;
+}
+
+void SignatureDatabase::add(SignatureTarget target,
+			    const std::vector<MaskPair> &words,
+			    std::vector<int> entries)
+{
+	matcher_.add(words.data(), words.size());
+	targets_.push_back(target);
+	entries_.push_back(std::move(entries));
+}
+
+static const char *const FileMagic = "emuspy-signatures";
+static const int FileVersion = 1;
+
+struct ParsedSignature {
+	SignatureTarget target;
+	std::vector<MaskPair> words;
+	std::vector<int> entries;
+};
+
+static bool ParseTarget(const std::string &name, SignatureTarget &target)
+{
+	for (int t = 0; t < SignatureTargetCount; t++) {
+		if (name == sTargetNames[t]) {
+			target = static_cast<SignatureTarget>(t);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Whole token as a number in 'base', 0 takes C prefixes and signs
+static bool ParseNumber(const std::string &token, int base, long long &value)
+{
+	if (token.empty())
+		return false;
+
+	char *end;
+	errno = 0;
+	value = strtoll(token.c_str(), &end, base);
+	return errno == 0 && *end == '\0';
+}
+
+// Words of RDRAM with the expansion pak, the most any image has
+static const int MaxRAMWords = 0x200000;
+// Entries further away from their signature are mistakes in the file
+static const int MaxEntryOffset = 0x10000;
+static_assert(MaxEntryOffset < MaxRAMWords,
+	      "every entry offset has to fit into some RAM");
+
+static bool ParseEntries(const std::string &token, std::vector<int> &entries)
+{
+	std::istringstream stream(token);
+	std::string offset;
+	while (std::getline(stream, offset, ',')) {
+		long long value;
+		if (!ParseNumber(offset, 0, value) || value < -MaxEntryOffset ||
+		    value > MaxEntryOffset)
+			return false;
+
+		entries.push_back(static_cast<int>(value));
+	}
+	return !entries.empty();
+}
+
+// Bits the mask leaves to any value may not be set in 'val', the word could
+// never match
+static bool ParseWord(const std::string &token, MaskPair &word)
+{
+	size_t slash = token.find('/');
+	long long val, mask = 0;
+	if (!ParseNumber(token.substr(0, slash), 16, val) ||
+	    (slash != std::string::npos &&
+	     !ParseNumber(token.substr(slash + 1), 16, mask)) ||
+	    val < 0 || val > 0xFFFFFFFF || mask < 0 || mask > 0xFFFFFFFF)
+		return false;
+
+	word = {static_cast<uint32_t>(val), static_cast<uint32_t>(mask)};
+	return 0 == (word.val & word.mask);
+}
+
+bool SignatureDatabase::parse(const std::string &text, std::string &error)
+{
+	std::vector<ParsedSignature> signatures;
+	std::vector<std::string> revisions;
+	int prologWords = prologWords_;
+	bool versioned = false;
+	// Indented lines go on with the words of the signature before them
+	bool inSignature = false;
+
+	std::istringstream lines(text);
+	std::string line;
+	for (int number = 1; std::getline(lines, line); number++) {
+		line = line.substr(0, line.find('#'));
+		bool indented =
+			!line.empty() &&
+			isspace(static_cast<unsigned char>(line[0]));
+		std::istringstream tokens(line);
+		std::string keyword;
+		if (!(tokens >> keyword))
+			continue;
+
+		auto fail = [&](const std::string &what) {
+			error = "line " + std::to_string(number) + ": " + what;
+			return false;
+		};
+
+		std::string argument;
+		if (!versioned) {
+			long long version;
+			if (keyword != FileMagic || !(tokens >> argument) ||
+			    !ParseNumber(argument, 10, version))
+				return fail("not a signature file");
+			if (version != FileVersion)
+				return fail("unsupported version " + argument);
+
+			versioned = true;
+		} else if (indented) {
+			if (!inSignature)
+				return fail("words outside of a signature");
+
+			// The first word was taken for a keyword
+			argument = keyword;
+			do {
+				MaskPair word{0, 0};
+				if (!ParseWord(argument, word))
+					return fail("bad word " + argument);
+
+				signatures.back().words.push_back(word);
+			} while (tokens >> argument);
+		} else if (keyword == "revision") {
+			if (!(tokens >> argument))
+				return fail("revision without a name");
+
+			revisions.push_back(argument);
+			inSignature = false;
+		} else if (keyword == "prolog-words") {
+			long long words;
+			if (!(tokens >> argument) ||
+			    !ParseNumber(argument, 10, words) || words < 0 ||
+			    words > 16)
+				return fail("prolog-words takes 0 to 16");
+
+			prologWords = std::max(prologWords,
+					       static_cast<int>(words));
+			inSignature = false;
+		} else {
+			ParsedSignature signature;
+			if (!ParseTarget(keyword, signature.target))
+				return fail("unknown target " + keyword);
+			if (!(tokens >> argument) ||
+			    !ParseEntries(argument, signature.entries))
+				return fail("bad entry offsets");
+
+			while (tokens >> argument) {
+				MaskPair word{0, 0};
+				if (!ParseWord(argument, word))
+					return fail("bad word " + argument);
+
+				signature.words.push_back(word);
+			}
+			signatures.push_back(std::move(signature));
+			inSignature = true;
+		}
+	}
+
+	if (!versioned) {
+		error = "not a signature file";
+		return false;
+	}
+	for (const auto &signature : signatures) {
+		if (signature.words.empty()) {
+			error = std::string("signature of ") +
+				sTargetNames[signature.target] +
+				" without words";
+			return false;
+		}
+	}
+
+	for (auto &signature : signatures)
+		add(signature.target, signature.words,
+		    std::move(signature.entries));
+	revisions_.insert(revisions_.end(), revisions.begin(), revisions.end());
+	prologWords_ = prologWords;
+	return true;
+}
+
+std::vector<std::vector<int>>
+SignatureDatabase::match(const std::vector<uint32_t> &mem, bool serial) const
+{
+	std::vector<std::vector<int>> matches = matcher_.match(mem, serial);
+	std::vector<std::vector<int>> ret(SignatureTargetCount);
+	// Entries come from the files and may point outside of RAM
+	long long size = static_cast<long long>(mem.size());
+	for (size_t id = 0; id < matches.size(); id++) {
+		std::vector<int> &entries = ret[targets_[id]];
+		for (int pos : matches[id]) {
+			for (int offset : entries_[id]) {
+				long long entry = static_cast<long long>(pos) +
+						  offset;
+				if (entry >= 0 && entry < size)
+					entries.push_back(pos + offset);
+			}
+		}
+	}
+
+	for (auto &entries : ret) {
+		std::sort(entries.begin(), entries.end());
+		entries.erase(std::unique(entries.begin(), entries.end()),
+			      entries.end());
+	}
+	return ret;
+}
+}
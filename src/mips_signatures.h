@@ -0,0 +1,72 @@
+#pragma once
+
+#include "mips_scanner.h"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace MIPS {
+
+// Code the analysis starts from, found by signature
+enum SignatureTarget {
+	TARGET_OS_GET_COUNT,
+	TARGET_OS_DISABLE_INT,
+	TARGET_OS_RESTORE_INT,
+	TARGET_OS_WRITEBACK_DCACHE,
+	TARGET_OS_INVAL_DCACHE,
+	// LUI GP and the ADDIU GP 2 words after it that set up GP at boot
+	TARGET_GP_SETUP,
+	SignatureTargetCount
+};
+
+// Signatures of every target with the offsets from a match to where the
+// target may start, one target may have signatures for several libultra
+// revisions and compilers. Signature files are text:
+//
+//   # comments run to the end of the line
+//   emuspy-signatures 1
+//   revision 2.0L-ido
+//   prolog-words 4
+//   __osDisableInt 0,-4 40006000/001F0000 2400FFFE/001F0000
+//       00000024/03FFF800 40806000/001F0000 30020001/03E00000
+//
+// The first line is the format version. 'prolog-words' is how many words
+// before a stack frame setup may already belong to the function, the largest
+// of all files is used. Every other line starts a signature: the target, the
+// comma separated offsets to its entries and the words as hexadecimal
+// 'val/mask' MaskPairs where the mask may be left out. Indented lines add
+// more words to the signature before them.
+class SignatureDatabase {
+public:
+	// The signatures the analyzer was written against
+	static const SignatureDatabase &builtIn();
+
+	// Adds the signatures of a signature file. Nothing is added if it has
+	// errors, the first one is described in 'error'.
+	bool parse(const std::string &text, std::string &error);
+
+	size_t size() const { return matcher_.size(); }
+	const std::vector<std::string> &revisions() const { return revisions_; }
+	int prologWords() const { return prologWords_; }
+
+	// Where every target may start, sorted and unique and indexed by
+	// 'SignatureTarget'. All signatures are matched in a single sweep over
+	// 'mem', in parallel unless 'serial' is set.
+	std::vector<std::vector<int>> match(const std::vector<uint32_t> &mem,
+					    bool serial = false) const;
+
+private:
+	void add(SignatureTarget target, const std::vector<MaskPair> &words,
+		 std::vector<int> entries);
+
+	SignatureMatcher matcher_;
+	// Indexed by the id of the signature in 'matcher_'
+	std::vector<SignatureTarget> targets_;
+	std::vector<std::vector<int>> entries_;
+
+	std::vector<std::string> revisions_;
+	int prologWords_ = 0;
+};
+}
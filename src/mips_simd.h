@@ -0,0 +1,15 @@
+#pragma once
+
+// MIPS_SCANNER_X86 is defined where SSE2 is always available, AVX2 functions
+// are marked with MIPS_TARGET_AVX2 and only called after checking the CPU
+#if defined(_M_X64) || defined(__SSE2__) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPS_SCANNER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MIPS_TARGET_AVX2
+#else
+#define MIPS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
@@ -0,0 +1,168 @@
+#include "mips_symbols.h"
+#include "mips_types.h"
+
+#include <algorithm>
+
+namespace MIPS {
+// Several osContInit candidates may pass one, they have to agree on it
+class ContPifRamLocator : public SymbolLocator {
+public:
+	Symbol symbol() const override { return SYMBOL_CONT_PIF_RAM; }
+
+	std::optional<KnownValue>
+	locate(const LocatorContext &context) const override
+	{
+		std::optional<KnownValue> best;
+		bool disagree = false;
+		for (const KnownValue &pifRam : context.osContPifRams) {
+			if (best && best->value != pifRam.value)
+				disagree = true;
+			if (!best || pifRam.confidence < best->confidence)
+				best = pifRam;
+		}
+
+		if (best && disagree)
+			best->confidence = CONFIDENCE_GUESSED;
+		return best;
+	}
+};
+
+// How far before its first osGetCount call viMgrMain counts the retrace
+static const int MaxIncrementDistance = 0x20;
+
+// Address 'base' holds at 'pos' if a LUI in [from, pos) sets it, GP is
+// taken from the context
+static std::optional<uint32_t> BaseAddress(const LocatorContext &context,
+					   int from, int pos, Register base)
+{
+	if (base == REG_GP)
+		return context.gp;
+
+	const DecodedRAM &code = context.code;
+	for (int i = pos - 1; i >= from; i--) {
+		if (code.rt(i) != base)
+			continue;
+		if (code.cmd(i) != CMD_LUI)
+			return std::nullopt;
+
+		return static_cast<uint32_t>(code.imm(i)) << 16;
+	}
+	return std::nullopt;
+}
+
+// Global word that the LW, ADDIU 1 and SW in [from, to) increment, like
+// '__osViIntrCount++' compiles to
+static std::optional<uint32_t> FindIncrement(const LocatorContext &context,
+					     int from, int to)
+{
+	const DecodedRAM &code = context.code;
+	for (int add = from; add < to; add++) {
+		if (code.cmd(add) != CMD_ADDIU || code.imm(add) != 1)
+			continue;
+
+		int load = add - 1;
+		while (load >= from && code.rt(load) != code.rs(add))
+			load--;
+		if (load < from || code.cmd(load) != CMD_LW)
+			continue;
+
+		int store = add + 1;
+		while (store < to && (code.cmd(store) != CMD_SW ||
+				      code.rt(store) != code.rt(add)))
+			store++;
+		if (store == to)
+			continue;
+
+		auto loadBase = BaseAddress(context, from, load, code.rs(load));
+		auto storeBase =
+			BaseAddress(context, from, store, code.rs(store));
+		if (!loadBase || !storeBase)
+			continue;
+
+		uint32_t loaded = *loadBase + static_cast<uint32_t>(
+						      code.imm(load));
+		uint32_t stored = *storeBase + static_cast<uint32_t>(
+						       code.imm(store));
+		if (loaded == stored && 0x80000000 == (loaded & 0xff800000))
+			return loaded;
+	}
+	return std::nullopt;
+}
+
+// viMgrMain counts every retrace right before it reads osGetCount to
+// advance the system time, only the callers of osGetCount are looked at
+class ViRetraceCountLocator : public SymbolLocator {
+public:
+	Symbol symbol() const override { return SYMBOL_VI_RETRACE_COUNT; }
+
+	std::optional<KnownValue>
+	locate(const LocatorContext &context) const override
+	{
+		const CallGraph &graph = context.graph;
+		std::optional<KnownValue> found;
+		for (int osGetCount : context.osGetCounts) {
+			for (int site : graph.callsTo(osGetCount)) {
+				int function = graph.functionAt(site);
+				if (function < 0)
+					continue;
+
+				// The store may be in the delay slot
+				int from = site - MaxIncrementDistance;
+				int to = site + 2;
+				auto counter = FindIncrement(
+					context,
+					std::max(graph.start(function), from),
+					std::min(graph.end(function), to));
+				if (!counter)
+					continue;
+
+				if (!found)
+					found = KnownValue{*counter,
+							   CONFIDENCE_EXACT};
+				else if (found->value != *counter)
+					found->confidence = CONFIDENCE_GUESSED;
+			}
+		}
+		return found;
+	}
+};
+
+// Boot code stores the RDRAM size at a fixed address before the game runs
+class MemSizeLocator : public SymbolLocator {
+public:
+	Symbol symbol() const override { return SYMBOL_MEM_SIZE; }
+
+	std::optional<KnownValue>
+	locate(const LocatorContext &context) const override
+	{
+		const uint32_t OsMemSize = 0x80000318;
+		const uint32_t MB = 0x100000;
+		size_t off = (OsMemSize & 0xffffff) / sizeof(uint32_t);
+		if (off >= context.mem.size())
+			return std::nullopt;
+
+		uint32_t size = context.mem[off];
+		if (size == 0 || size % MB != 0 || size > 8 * MB)
+			return std::nullopt;
+
+		// A size other than the dump's means the value is stale
+		if (size != context.mem.size() * sizeof(uint32_t))
+			return KnownValue{OsMemSize, CONFIDENCE_ASSUMED};
+
+		return KnownValue{OsMemSize, CONFIDENCE_EXACT};
+	}
+};
+
+const std::vector<const SymbolLocator *> &SymbolLocators()
+{
+	static const ContPifRamLocator sContPifRam;
+	static const ViRetraceCountLocator sViRetraceCount;
+	static const MemSizeLocator sMemSize;
+	static const std::vector<const SymbolLocator *> sLocators = {
+		&sContPifRam,
+		&sViRetraceCount,
+		&sMemSize,
+	};
+	return sLocators;
+}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "mips_analyzer.h"
+#include "mips_callgraph.h"
+#include "mips_dataflow.h"
+#include "mips_predecode.h"
+
+#include <stdint.h>
+
+#include <optional>
+#include <vector>
+
+namespace MIPS {
+
+// What 'analyze' found in its passes over all of RAM and on the way to
+// gControllerPads. Locators only query it, none of them may go over RAM again.
+struct LocatorContext {
+	const std::vector<uint32_t> &mem;
+	const DecodedRAM &code;
+	const CallGraph &graph;
+	std::optional<uint32_t> gp;
+
+	// Entries of osGetCount, sorted
+	const std::vector<int> &osGetCounts;
+	// A1 of the __osSiRawStartDma calls of every osContInit candidate
+	const std::vector<KnownValue> &osContPifRams;
+};
+
+// Finds one global, adding a symbol takes a locator and its place in
+// 'SymbolLocators'
+class SymbolLocator {
+public:
+	virtual ~SymbolLocator() = default;
+
+	virtual Symbol symbol() const = 0;
+	// Address of the symbol, nothing if it is not in RAM
+	virtual std::optional<KnownValue>
+	locate(const LocatorContext &context) const = 0;
+};
+
+// Every locator besides the one for gControllerPads in the order of 'Symbol'
+const std::vector<const SymbolLocator *> &SymbolLocators();
+}
@@ -237,6 +237,9 @@ enum Cmd {
 	CMD_MTC1 = CMD_COP1 | COP_MT,
 };
 
+// Every Cmd fits in 10 bits, flat tables indexed by Cmd have this many entries
+static const uint32_t CmdCount = 0x400;
+
 enum Register {
 	REG_R0,
 	REG_AT,
@@ -346,5 +349,7 @@ enum Format {
 	FORMAT_REGOFF_CACHE = FORMAT_REG_S | FORMAT_CACHE_T | FORMAT_OFF,
 
 	FORMAT_NONE = 0,
+	// The encoding is not supported, no other bits are set
+	FORMAT_INVALID = 0b10000000000,
 };
 }
@@ -0,0 +1,74 @@
+#include "mips_xref.h"
+#include "mips_parallel.h"
+#include "mips_types.h"
+
+#include <algorithm>
+
+namespace MIPS {
+CallIndex::CallIndex(const std::vector<uint32_t> &mem, bool serial)
+{
+	size_t chunks = ChunksCount(mem.size(), AnalyzeChunkSize);
+	std::vector<std::vector<uint64_t>> chunkCalls(chunks);
+	ForEachChunk(mem.size(), AnalyzeChunkSize, serial,
+		     [&](size_t chunk, size_t begin, size_t end) {
+			     std::vector<uint64_t> &calls = chunkCalls[chunk];
+			     for (size_t i = begin; i < end; ++i) {
+				     uint32_t inst = mem[i];
+				     if ((inst >> 26) != OP_JAL)
+					     continue;
+
+				     // target in the high half keeps sites
+				     // ordered within a target
+				     uint64_t target = inst & 0x3FFFFFF;
+				     calls.push_back((target << 32) |
+						     static_cast<uint32_t>(i));
+			     }
+
+			     std::sort(calls.begin(), calls.end());
+		     });
+
+	// merging sorted chunks in order gives the same result as sorting
+	// everything at once
+	std::vector<uint64_t> calls;
+	for (const auto &chunk : chunkCalls) {
+		size_t sorted = calls.size();
+		calls.insert(calls.end(), chunk.begin(), chunk.end());
+		std::inplace_merge(calls.begin(), calls.begin() + sorted,
+				   calls.end());
+	}
+
+	sites_.reserve(calls.size());
+	for (uint64_t call : calls) {
+		uint32_t target = static_cast<uint32_t>(call >> 32);
+		if (targets_.empty() || targets_.back() != target) {
+			targets_.push_back(target);
+			offsets_.push_back(
+				static_cast<uint32_t>(sites_.size()));
+		}
+
+		sites_.push_back(static_cast<int>(call & 0xffffffff));
+	}
+	offsets_.push_back(static_cast<uint32_t>(sites_.size()));
+}
+
+Sites Sites::between(int lowest, int highest) const
+{
+	const int *lower = std::lower_bound(first, last, lowest);
+	return {lower, std::upper_bound(lower, last, highest)};
+}
+
+Sites CallIndex::callsTo(int pos) const
+{
+	if (pos < 0)
+		return {};
+
+	uint32_t target = static_cast<uint32_t>(pos);
+	auto it = std::lower_bound(targets_.begin(), targets_.end(), target);
+	if (it == targets_.end() || *it != target)
+		return {};
+
+	size_t idx = static_cast<size_t>(it - targets_.begin());
+	const int *sites = sites_.data();
+	return {sites + offsets_[idx], sites + offsets_[idx + 1]};
+}
+}
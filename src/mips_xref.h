@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace MIPS {
+
+// Non-owning view over a contiguous run of RAM word indices
+struct Sites {
+	const int *first = nullptr;
+	const int *last = nullptr;
+
+	const int *begin() const { return first; }
+	const int *end() const { return last; }
+	size_t size() const { return static_cast<size_t>(last - first); }
+	bool empty() const { return first == last; }
+
+	// Sites from 'lowest' to 'highest', both included, without copying
+	// them. Only for sorted sites.
+	Sites between(int lowest, int highest) const;
+};
+
+// Maps every JAL target in RAM to the word indices of its call sites.
+// Built in a single pass and stored in CSR form: 'targets_' is sorted and
+// unique, sites for targets_[i] live in sites_[offsets_[i], offsets_[i + 1])
+// and are sorted as well.
+class CallIndex {
+public:
+	// Chunks of RAM are scanned in parallel unless 'serial' is set, the
+	// resulting index is the same either way
+	explicit CallIndex(const std::vector<uint32_t> &mem,
+			   bool serial = false);
+
+	Sites callsTo(int pos) const;
+
+	size_t targetsCount() const { return targets_.size(); }
+	size_t sitesCount() const { return sites_.size(); }
+
+private:
+	std::vector<uint32_t> targets_;
+	std::vector<uint32_t> offsets_;
+	std::vector<int> sites_;
+};
+}
@@ -18,9 +18,12 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 
 #include <obs-module.h>
 #include <plugin-support.h>
+#include <util/platform.h>
 
+#include "analysis_cache.h"
 #include "dispatch_queue.h"
 #include "emuspy-source.h"
+#include "signature_files.h"
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE(PLUGIN_NAME, "en-US")
@@ -33,6 +36,16 @@ bool obs_module_load(void)
 	gTeardownQueue = new QueueExecutor;
 	gTeardownQueue->start();
 
+	if (char *configPath = obs_module_config_path("")) {
+		os_mkdirs(configPath);
+		bfree(configPath);
+	}
+	if (char *cachePath = obs_module_config_path("analysis-cache.bin")) {
+		gAnalysisCache = new AnalysisCache(cachePath);
+		bfree(cachePath);
+	}
+	gSignatures = loadSignatureFiles();
+
 	obs_source_info emuSpySource = EmuSpy::makeOBSSourceInfo();
 	obs_register_source(&emuSpySource);
 	return true;
@@ -42,4 +55,6 @@ void obs_module_unload(void)
 {
 	obs_log(LOG_INFO, "plugin unloaded");
 	delete gTeardownQueue;
+	delete gAnalysisCache;
+	delete gSignatures;
 }
@@ -0,0 +1,70 @@
+#include "signature_files.h"
+
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/platform.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// In name order so the result does not depend on the file system
+static void addDirectory(MIPS::SignatureDatabase &database, const char *dir)
+{
+	os_dir_t *handle = os_opendir(dir);
+	if (!handle)
+		return;
+
+	std::vector<std::string> names;
+	while (os_dirent *entry = os_readdir(handle)) {
+		const char *ext = os_get_path_extension(entry->d_name);
+		if (!entry->directory && ext && 0 == strcmp(ext, ".sig"))
+			names.push_back(entry->d_name);
+	}
+	os_closedir(handle);
+	std::sort(names.begin(), names.end());
+
+	for (const auto &name : names) {
+		std::string path = std::string(dir) + "/" + name;
+		char *text = os_quick_read_utf8_file(path.c_str());
+		if (!text) {
+			obs_log(LOG_WARNING, "%s: failed to read",
+				path.c_str());
+			continue;
+		}
+
+		std::string error;
+		if (!database.parse(text, error))
+			obs_log(LOG_WARNING, "%s: %s", path.c_str(),
+				error.c_str());
+		bfree(text);
+	}
+}
+
+const MIPS::SignatureDatabase *loadSignatureFiles()
+{
+	auto database = new MIPS::SignatureDatabase;
+	if (char *dir = obs_module_file("signatures")) {
+		addDirectory(*database, dir);
+		bfree(dir);
+	}
+	if (char *dir = obs_module_config_path("signatures")) {
+		addDirectory(*database, dir);
+		bfree(dir);
+	}
+
+	if (0 == database->size()) {
+		obs_log(LOG_WARNING,
+			"no signature files, using built-in signatures");
+		delete database;
+		return nullptr;
+	}
+
+	obs_log(LOG_INFO, "%zu signatures loaded from %zu revisions",
+		database->size(), database->revisions().size());
+	return database;
+}
+
+const MIPS::SignatureDatabase *gSignatures = nullptr;
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "mips_signatures.h"
+
+// Reads the '.sig' files shipped in the plugin data and those added to the
+// signatures folder of the plugin configuration, so new games can be covered
+// without a new build. Files with errors are logged and skipped. Nothing if
+// no signature was loaded, the analyzer falls back to its built-in ones then.
+const MIPS::SignatureDatabase *loadSignatureFiles();
+
+extern const MIPS::SignatureDatabase *gSignatures;
@@ -0,0 +1,192 @@
+#include "allocation_counter.h"
+
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include <atomic>
+#include <new>
+
+// The replacements live apart from their callers, GCC warns about free()
+// on memory from operator new once they are inlined into them
+static std::atomic<size_t> sAllocations{0};
+static std::atomic<size_t> sLiveAllocations{0};
+static std::atomic<size_t> sPeakLiveAllocations{0};
+
+size_t allocationsMade()
+{
+	return sAllocations;
+}
+
+size_t allocationsLive()
+{
+	return sLiveAllocations;
+}
+
+void resetPeakAllocations()
+{
+	sPeakLiveAllocations = sLiveAllocations.load();
+}
+
+size_t peakAllocations()
+{
+	return sPeakLiveAllocations;
+}
+
+// Nothing if it fails, 'alignment' is 0 for the default one
+static void *allocate(size_t size, size_t alignment) noexcept
+{
+	if (size == 0)
+		size = 1;
+
+	void *ptr;
+#ifdef _WIN32
+	ptr = alignment ? _aligned_malloc(size, alignment) : malloc(size);
+#else
+	// aligned_alloc takes whole multiples of the alignment only
+	ptr = alignment ? aligned_alloc(alignment,
+					(size + alignment - 1) / alignment *
+						alignment)
+			: malloc(size);
+#endif
+	if (!ptr)
+		return nullptr;
+
+	sAllocations++;
+	size_t live = ++sLiveAllocations;
+	size_t peak = sPeakLiveAllocations.load();
+	while (live > peak &&
+	       !sPeakLiveAllocations.compare_exchange_weak(peak, live)) {
+	}
+	return ptr;
+}
+
+static void *allocateOrThrow(size_t size, size_t alignment)
+{
+	void *ptr = allocate(size, alignment);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+static void release(void *ptr, bool aligned) noexcept
+{
+	if (!ptr)
+		return;
+
+	sLiveAllocations--;
+#ifdef _WIN32
+	if (aligned) {
+		_aligned_free(ptr);
+		return;
+	}
+#else
+	(void)aligned;
+#endif
+	free(ptr);
+}
+
+void *operator new(size_t size)
+{
+	return allocateOrThrow(size, 0);
+}
+
+void *operator new[](size_t size)
+{
+	return allocateOrThrow(size, 0);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return allocate(size, 0);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return allocate(size, 0);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+	return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void *operator new(size_t size, std::align_val_t alignment,
+		   const std::nothrow_t &) noexcept
+{
+	return allocate(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment,
+		     const std::nothrow_t &) noexcept
+{
+	return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept
+{
+	release(ptr, false);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	release(ptr, false);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	release(ptr, false);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+	release(ptr, false);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	release(ptr, false);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	release(ptr, false);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+	release(ptr, true);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+	release(ptr, true);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+	release(ptr, true);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept
+{
+	release(ptr, true);
+}
+
+void operator delete(void *ptr, std::align_val_t,
+		     const std::nothrow_t &) noexcept
+{
+	release(ptr, true);
+}
+
+void operator delete[](void *ptr, std::align_val_t,
+		       const std::nothrow_t &) noexcept
+{
+	release(ptr, true);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+
+// Counts the heap allocations of the whole program. allocation_counter.cpp
+// replaces every form of the global operator new and delete: plain, array,
+// nothrow, sized and aligned.
+
+// Allocations made so far and how many of them are alive
+size_t allocationsMade();
+size_t allocationsLive();
+
+// The most allocations alive at once since the last reset
+void resetPeakAllocations();
+size_t peakAllocations();
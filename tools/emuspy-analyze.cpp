@@ -0,0 +1,1225 @@
+// Runs MIPS::analyze over raw RDRAM dumps, without OBS or an emulator
+//
+//   emuspy-analyze [--signatures FILE]... [--serial] [--repeat N] <dump>...
+//   emuspy-analyze --bench [--serial] [--repeat N] <directory>
+//   emuspy-analyze --synth COUNT [--seed S] [--expansion] [--write DIR]
+//                  [--serial] [--repeat N]
+//   emuspy-analyze --faults COUNT [--seed S] [--repeat N]
+//   emuspy-analyze --classify [--seed S] [--repeat N]
+//   emuspy-analyze --scan [--seed S] [--repeat N]
+//   emuspy-analyze --decode [--seed S]
+//   emuspy-analyze --dataflow
+//
+// Dumps are raw 4 or 8 MB images of RDRAM as 32-bit words. Both the byte order
+// emulators keep RDRAM in and big endian dumps are accepted.
+//
+// --signatures replaces the built-in signatures with those of every FILE, in
+// the format 'MIPS::SignatureDatabase' parses, in any mode that analyzes.
+//
+// --synth generates COUNT images with seeds S, S + 1, ... instead of reading
+// dumps and checks the results against the planted gControllerPads. --write
+// also saves them to DIR so they can be fed back with --bench.
+//
+// --faults interprets COUNT windows of a synthetic image at random offsets, the
+// way 'analyze' interprets the code before a candidate JAL. Most of them read
+// and write through registers that do not hold addresses, so it measures the
+// interpreter on fault-heavy input. Every window runs through both
+// 'Interpreter::execute' and 'Interpreter::run', which have to agree.
+//
+// Every report also counts the heap allocations one analysis makes and the
+// most of them that are alive at once, through every form of the global
+// operator new (allocation_counter.cpp).
+//
+// --classify runs every word classification kernel the CPU supports over a 4
+// and an 8 MB synthetic image on one thread and reports their throughput.
+// The vector kernels have to agree with the scalar one.
+//
+// --decode decodes every combination of the opcode, rs, rt and funct fields,
+// all the bits 'decodeCmd' looks at, with random rd and shift fields, and as
+// many fully random words. 'decodeCmd' has to give the Cmd 'decodePacked'
+// and 'decodeInstruction' do, or CmdCount exactly where they decode nothing.
+//
+// --dataflow propagates constants to the JAL of hand-assembled windows with
+// branches, likely delay slots, loops, earlier calls, stack spills and GP
+// relative stores and compares the registers and stored words with what
+// each window expects.
+//
+// --scan searches random and synthetic images for patterns cut out of them,
+// some words with wildcard fields, with every 'IndicesOf' kernel the CPU
+// supports. Random images have lengths that leave a tail after the last
+// full vector step and some are shorter than the patterns. The vector kernels
+// have to find the same indices as the scalar one. The patterns also go
+// through a 'SignatureMatcher' with every kernel, once only the first few of
+// an image so the vector compare of their first words runs and once all of
+// them so only the dispatch table does.
+
+#include "allocation_counter.h"
+#include "mips_analyzer.h"
+#include "mips_assembler.h"
+#include "mips_classify.h"
+#include "mips_dataflow.h"
+#include "mips_decompiler.h"
+#include "mips_interpreter.h"
+#include "mips_scanner.h"
+#include "mips_signatures.h"
+#include "synthetic_ram.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct Options {
+	bool bench = false;
+	int repeat = 1;
+	int synth = 0;
+	int faults = 0;
+	bool classify = false;
+	bool scan = false;
+	bool decode = false;
+	bool dataflow = false;
+	uint32_t seed = 1;
+	bool expansion = false;
+	std::string write;
+	std::vector<std::string> signatures;
+	MIPS::AnalyzeOptions analyze;
+	std::vector<std::string> paths;
+};
+
+// Allocations made during one analysis and the most of them alive at once,
+// not counting what was allocated before it
+struct Allocations {
+	size_t count = 0;
+	size_t peak = 0;
+
+	void max(const Allocations &other)
+	{
+		count = std::max(count, other.count);
+		peak = std::max(peak, other.peak);
+	}
+};
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: emuspy-analyze [--signatures FILE]... [--serial] "
+		"[--repeat N] <dump>...\n"
+		"       emuspy-analyze --bench [--serial] [--repeat N] "
+		"<directory>\n"
+		"       emuspy-analyze --synth COUNT [--seed S] [--expansion] "
+		"[--write DIR] [--serial] [--repeat N]\n"
+		"       emuspy-analyze --faults COUNT [--seed S] "
+		"[--repeat N]\n"
+		"       emuspy-analyze --classify [--seed S] [--repeat N]\n"
+		"       emuspy-analyze --scan [--seed S] [--repeat N]\n"
+		"       emuspy-analyze --decode [--seed S]\n"
+		"       emuspy-analyze --dataflow\n");
+}
+
+static bool loadSignatures(const std::vector<std::string> &paths,
+			   MIPS::SignatureDatabase &signatures)
+{
+	for (const auto &path : paths) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			fprintf(stderr, "%s: failed to read\n", path.c_str());
+			return false;
+		}
+
+		std::string text((std::istreambuf_iterator<char>(file)),
+				 std::istreambuf_iterator<char>());
+		std::string error;
+		if (!signatures.parse(text, error)) {
+			fprintf(stderr, "%s: %s\n", path.c_str(),
+				error.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint32_t byteSwap(uint32_t val)
+{
+	return (val >> 24) | ((val >> 8) & 0xff00) | ((val << 8) & 0xff0000) |
+	       (val << 24);
+}
+
+// Same probe 'Emulator' uses to find RDRAM in the emulator process
+static bool isRAMMagic(uint32_t val)
+{
+	const uint32_t ramMagic = 0x3C1A8000;
+	const uint32_t ramMagicMask = 0xfffff000;
+	return (val & ramMagicMask) == ramMagic;
+}
+
+static std::optional<std::vector<uint32_t>> loadDump(const fs::path &path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return std::nullopt;
+
+	std::streamoff size = file.tellg();
+	if (size != 0x400000 && size != 0x800000)
+		return std::nullopt;
+
+	std::vector<uint32_t> ram(static_cast<size_t>(size) / sizeof(uint32_t));
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char *>(ram.data()), size))
+		return std::nullopt;
+
+	if (!isRAMMagic(ram[0]) && isRAMMagic(byteSwap(ram[0])))
+		std::transform(ram.begin(), ram.end(), ram.begin(), byteSwap);
+
+	return ram;
+}
+
+static double analyzeTimed(const std::vector<uint32_t> &ram,
+			   const MIPS::AnalyzeOptions &options,
+			   std::optional<MIPS::AnalyzeResult> &result,
+			   Allocations &allocations)
+{
+	result.reset();
+	size_t before = allocationsMade();
+	size_t live = allocationsLive();
+	resetPeakAllocations();
+
+	auto start = std::chrono::steady_clock::now();
+	result = MIPS::analyze(ram, options);
+	std::chrono::duration<double, std::milli> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	allocations.count = allocationsMade() - before;
+	allocations.peak = peakAllocations() - live;
+	return elapsed.count();
+}
+
+static const char *confidenceName(MIPS::Confidence confidence)
+{
+	switch (confidence) {
+	case MIPS::CONFIDENCE_EXACT:
+		return "exact";
+	case MIPS::CONFIDENCE_ASSUMED:
+		return "assumed";
+	case MIPS::CONFIDENCE_GUESSED:
+		return "guessed";
+	}
+	return "?";
+}
+
+static void printResult(const std::optional<MIPS::AnalyzeResult> &result)
+{
+	if (!result) {
+		printf("  no gControllerPads found\n");
+		return;
+	}
+
+	printf("  gControllerPads 0x%08X, verifier %zu instructions at "
+	       "0x%08X\n",
+	       static_cast<uint32_t>(result->gControllerPads),
+	       result->interpretedInstructions.size(),
+	       0x80000000u | (static_cast<uint32_t>(
+				      result->interpretedInstructionsOffset)
+			      << 2));
+	printf("  %zu gControllerPads candidates, margin %d\n",
+	       result->controllerPadsCandidates.size(),
+	       result->controllerPadsMargin);
+	for (const auto &candidate : result->controllerPadsCandidates)
+		printf("    0x%08X score %d, %s status\n", candidate.address,
+		       candidate.score, confidenceName(candidate.confidence));
+	for (const auto &symbol : result->symbols)
+		printf("  %-20s 0x%08X %s\n", MIPS::SymbolName(symbol.symbol),
+		       symbol.address, confidenceName(symbol.confidence));
+}
+
+static int analyzeDump(const std::string &path, const Options &options)
+{
+	auto ram = loadDump(path);
+	if (!ram) {
+		fprintf(stderr, "%s: not a 4 or 8 MB RDRAM dump\n",
+			path.c_str());
+		return 1;
+	}
+
+	// Phase stats are reported for the last run, totals for all of them
+	MIPS::AnalyzeStats stats;
+	MIPS::AnalyzeOptions analyzeOptions = options.analyze;
+	std::optional<MIPS::AnalyzeResult> result;
+	Allocations allocations;
+	double best = 0, sum = 0;
+	for (int i = 0; i < options.repeat; i++) {
+		stats.phases.clear();
+		analyzeOptions.stats = &stats;
+		double ms = analyzeTimed(*ram, analyzeOptions, result,
+					 allocations);
+		best = i == 0 ? ms : std::min(best, ms);
+		sum += ms;
+	}
+
+	printf("%s: %zu KB\n", path.c_str(), ram->size() * 4 / 1024);
+	for (const auto &phase : stats.phases) {
+		printf("  %-20s %9.3f ms  candidates %8zu  found %8zu\n",
+		       phase.name.c_str(), phase.milliseconds,
+		       phase.candidates, phase.found);
+	}
+	printf("  %-20s %9.3f ms  (best of %d, mean %.3f ms)\n", "total",
+	       best, options.repeat, sum / options.repeat);
+	uint64_t decoded = stats.decodeCacheHits + stats.decodeCacheMisses;
+	printf("  %-20s %9llu hits %9llu misses (%.1f%%)\n", "decode cache",
+	       static_cast<unsigned long long>(stats.decodeCacheHits),
+	       static_cast<unsigned long long>(stats.decodeCacheMisses),
+	       decoded ? 100.0 * static_cast<double>(stats.decodeCacheHits) /
+				 static_cast<double>(decoded)
+		       : 0.0);
+	printf("  %-20s %9zu propagated %6zu interpreted\n", "call arguments",
+	       stats.argumentsPropagated, stats.argumentsInterpreted);
+	printf("  %-20s %9zu total     %9zu peak live\n", "allocations",
+	       allocations.count, allocations.peak);
+	printResult(result);
+	return result ? 0 : 2;
+}
+
+static int bench(const std::string &directory, const Options &options)
+{
+	std::vector<fs::path> dumps;
+	std::error_code ec;
+	for (const auto &entry : fs::directory_iterator(directory, ec)) {
+		if (entry.is_regular_file())
+			dumps.push_back(entry.path());
+	}
+	if (ec) {
+		fprintf(stderr, "%s: %s\n", directory.c_str(),
+			ec.message().c_str());
+		return 1;
+	}
+
+	std::sort(dumps.begin(), dumps.end());
+
+	printf("%-40s %10s %10s  %s\n", "dump", "best ms", "mean ms",
+	       "gControllerPads");
+	size_t analyzed = 0, found = 0;
+	double totalBest = 0;
+	Allocations mostAllocations;
+	for (const auto &path : dumps) {
+		auto ram = loadDump(path);
+		if (!ram)
+			continue;
+
+		std::optional<MIPS::AnalyzeResult> result;
+		Allocations allocations;
+		double best = 0, sum = 0;
+		for (int i = 0; i < options.repeat; i++) {
+			double ms = analyzeTimed(*ram, options.analyze, result,
+						 allocations);
+			best = i == 0 ? ms : std::min(best, ms);
+			sum += ms;
+		}
+
+		analyzed++;
+		totalBest += best;
+		mostAllocations.max(allocations);
+		if (result) {
+			found++;
+			printf("%-40s %10.3f %10.3f  0x%08X\n",
+			       path.filename().string().c_str(), best,
+			       sum / options.repeat,
+			       static_cast<uint32_t>(result->gControllerPads));
+		} else {
+			printf("%-40s %10.3f %10.3f  -\n",
+			       path.filename().string().c_str(), best,
+			       sum / options.repeat);
+		}
+	}
+
+	printf("%zu dumps, %zu found, %.3f ms total best\n", analyzed, found,
+	       totalBest);
+	printf("at most %zu allocations, %zu of them live at once, per dump\n",
+	       mostAllocations.count, mostAllocations.peak);
+	return analyzed ? 0 : 1;
+}
+
+static bool writeDump(const fs::path &path, const std::vector<uint32_t> &ram)
+{
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char *>(ram.data()),
+		   static_cast<std::streamsize>(ram.size() * sizeof(uint32_t)));
+	return static_cast<bool>(file);
+}
+
+// Every planted symbol found at its address, the confidence does not matter
+static bool symbolsMatch(const MIPS::AnalyzeResult &result,
+			 const SyntheticRAM &image)
+{
+	uint32_t expected[MIPS::SymbolCount] = {
+		image.gControllerPads,
+		image.osContPifRam,
+		image.viIntrCount,
+		OsMemSize,
+	};
+	for (int s = 0; s < MIPS::SymbolCount; s++) {
+		if (std::none_of(result.symbols.begin(), result.symbols.end(),
+				 [&](const MIPS::LocatedSymbol &symbol) {
+					 return symbol.symbol == s &&
+						symbol.address == expected[s];
+				 }))
+			return false;
+	}
+	return true;
+}
+
+static int synth(const Options &options)
+{
+	SyntheticOptions synthOptions;
+	if (options.expansion)
+		synthOptions.words = 0x200000;
+
+	printf("%-10s %10s %10s  %-10s  %s\n", "seed", "best ms", "mean ms",
+	       "expected", "gControllerPads");
+	int correct = 0;
+	double totalBest = 0;
+	Allocations mostAllocations;
+	for (int i = 0; i < options.synth; i++) {
+		uint32_t seed = options.seed + static_cast<uint32_t>(i);
+		SyntheticRAM image = GenerateSyntheticRAM(seed, synthOptions);
+		if (!options.write.empty()) {
+			fs::path path = fs::path(options.write) /
+					("synth-" + std::to_string(seed) +
+					 ".bin");
+			if (!writeDump(path, image.ram)) {
+				fprintf(stderr, "%s: failed to write\n",
+					path.string().c_str());
+				return 1;
+			}
+		}
+
+		std::optional<MIPS::AnalyzeResult> result;
+		Allocations allocations;
+		double best = 0, sum = 0;
+		for (int j = 0; j < options.repeat; j++) {
+			double ms = analyzeTimed(image.ram, options.analyze,
+						 result, allocations);
+			best = j == 0 ? ms : std::min(best, ms);
+			sum += ms;
+		}
+		totalBest += best;
+		mostAllocations.max(allocations);
+
+		// The verifier segment has to be the one leading to the
+		// planted call too, the right address alone is not enough
+		bool ok = result &&
+			  static_cast<uint32_t>(result->gControllerPads) ==
+				  image.gControllerPads &&
+			  result->interpretedInstructionsOffset ==
+				  image.osContInitCall - 20 &&
+			  symbolsMatch(*result, image);
+		if (ok)
+			correct++;
+
+		printf("%-10u %10.3f %10.3f  0x%08X  ", seed, best,
+		       sum / options.repeat, image.gControllerPads);
+		if (!result)
+			printf("-\n");
+		else
+			printf("0x%08X%s\n",
+			       static_cast<uint32_t>(result->gControllerPads),
+			       ok ? "" : " MISMATCH");
+	}
+
+	double megabytes = static_cast<double>(options.synth) *
+			   (options.expansion ? 8 : 4);
+	printf("%d images, %d correct, %.3f ms total best, %.1f MB/s\n",
+	       options.synth, correct, totalBest,
+	       totalBest > 0 ? megabytes * 1000 / totalBest : 0);
+	printf("at most %zu allocations, %zu of them live at once, per image\n",
+	       mostAllocations.count, mostAllocations.peak);
+	return correct == options.synth ? 0 : 2;
+}
+
+static const int FaultWindowLength = 20;
+
+// Either one 'getInstruction' and 'execute' per instruction or 'run'
+static void interpretWindow(MIPS::Interpreter &interpreter, uint32_t window,
+			    bool fast)
+{
+	interpreter.reset(0x80000000u | (window << 2));
+	if (fast) {
+		interpreter.run(FaultWindowLength);
+		return;
+	}
+
+	for (int i = 0; i < FaultWindowLength; i++) {
+		auto inst = interpreter.getInstruction();
+		if (inst.has_value())
+			interpreter.execute(inst.value());
+	}
+}
+
+static double timeWindows(MIPS::Interpreter &interpreter,
+			  const std::vector<uint32_t> &windows, bool fast,
+			  int repeat)
+{
+	double best = 0;
+	for (int i = 0; i < repeat; i++) {
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t window : windows)
+			interpretWindow(interpreter, window, fast);
+		std::chrono::duration<double, std::milli> elapsed =
+			std::chrono::steady_clock::now() - start;
+		best = i == 0 ? elapsed.count()
+			      : std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+static bool sameState(const MIPS::Interpreter &a, const MIPS::Interpreter &b)
+{
+	return std::equal(std::begin(a.gpr), std::end(a.gpr),
+			  std::begin(b.gpr)) &&
+	       a.lo == b.lo && a.hi == b.hi && a.pc == b.pc &&
+	       a.faults == b.faults;
+}
+
+static int faults(const Options &options)
+{
+	SyntheticRAM image = GenerateSyntheticRAM(options.seed);
+	std::mt19937 rng(options.seed);
+	std::vector<uint32_t> windows(static_cast<size_t>(options.faults));
+	for (auto &window : windows)
+		window = static_cast<uint32_t>(rng()) %
+			 static_cast<uint32_t>(image.ram.size() -
+					       FaultWindowLength);
+
+	// Number of windows that ran into each Fault, and the ones where
+	// 'run' ended up in another state than 'execute'
+	const uint32_t FaultKinds[] = {MIPS::FAULT_FETCH, MIPS::FAULT_LOAD,
+				       MIPS::FAULT_STORE,
+				       MIPS::FAULT_DIVIDE_BY_ZERO,
+				       MIPS::FAULT_LOOP};
+	size_t faulted[5]{};
+	size_t mismatches = 0;
+	MIPS::Interpreter reference(image.ram);
+	MIPS::Interpreter interpreter(image.ram);
+	for (uint32_t window : windows) {
+		interpretWindow(reference, window, false);
+		interpretWindow(interpreter, window, true);
+		if (!sameState(reference, interpreter))
+			mismatches++;
+		for (int k = 0; k < 5; k++) {
+			if (reference.faults & FaultKinds[k])
+				faulted[k]++;
+		}
+	}
+
+	double instructions =
+		static_cast<double>(windows.size()) * FaultWindowLength;
+	printf("%d windows of %d instructions, best of %d\n", options.faults,
+	       FaultWindowLength, options.repeat);
+	for (bool fast : {false, true}) {
+		double ms = timeWindows(interpreter, windows, fast,
+					options.repeat);
+		printf("  %-8s %10.3f ms  %6.1f ns/instruction\n",
+		       fast ? "run" : "execute", ms, ms * 1e6 / instructions);
+	}
+	printf("windows faulting on fetch %zu, load %zu, store %zu, "
+	       "divide by zero %zu, loop %zu\n",
+	       faulted[0], faulted[1], faulted[2], faulted[3], faulted[4]);
+	printf("%zu windows differ between execute and run\n", mismatches);
+	return mismatches ? 2 : 0;
+}
+
+static size_t countBits(const std::vector<uint64_t> &mask)
+{
+	size_t count = 0;
+	for (uint64_t bits : mask) {
+		for (; bits; bits &= bits - 1)
+			count++;
+	}
+	return count;
+}
+
+static double timeClassify(const std::vector<uint32_t> &ram,
+			   uint64_t *const masks[MIPS::WordClassCount],
+			   MIPS::ScanKernel kernel, int repeat)
+{
+	double best = 0;
+	for (int i = 0; i < repeat; i++) {
+		auto start = std::chrono::steady_clock::now();
+		MIPS::ClassifyWords(ram.data(), ram.size(), masks, kernel);
+		std::chrono::duration<double, std::milli> elapsed =
+			std::chrono::steady_clock::now() - start;
+		best = i == 0 ? elapsed.count()
+			      : std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+static int classify(const Options &options)
+{
+	const char *const KernelNames[] = {"scalar", "sse2", "avx2"};
+	const char *const ClassNames[MIPS::WordClassCount] = {
+		"jal", "prolog", "return", "lui", "cache", "status"};
+
+	size_t mismatches = 0;
+	for (size_t words : {0x100000u, 0x200000u}) {
+		SyntheticOptions synthOptions;
+		synthOptions.words = words;
+		SyntheticRAM image =
+			GenerateSyntheticRAM(options.seed, synthOptions);
+
+		// One mask per class for the scalar kernel and one for the
+		// kernel that is timed
+		size_t maskWords = (words + 63) / 64;
+		std::vector<uint64_t> reference[MIPS::WordClassCount];
+		std::vector<uint64_t> masks[MIPS::WordClassCount];
+		uint64_t *referencePtrs[MIPS::WordClassCount];
+		uint64_t *maskPtrs[MIPS::WordClassCount];
+		for (int c = 0; c < MIPS::WordClassCount; c++) {
+			reference[c].resize(maskWords);
+			masks[c].resize(maskWords);
+			referencePtrs[c] = reference[c].data();
+			maskPtrs[c] = masks[c].data();
+		}
+		MIPS::ClassifyWords(image.ram.data(), words, referencePtrs,
+				    MIPS::SCAN_KERNEL_SCALAR);
+
+		printf("%zu KB image, best of %d\n", words * 4 / 1024,
+		       options.repeat);
+		for (int k = MIPS::SCAN_KERNEL_SCALAR;
+		     k <= MIPS::BestScanKernel(); k++) {
+			double best = timeClassify(
+				image.ram, maskPtrs,
+				static_cast<MIPS::ScanKernel>(k),
+				options.repeat);
+			bool same = std::equal(std::begin(masks),
+					       std::end(masks),
+					       std::begin(reference));
+			if (!same)
+				mismatches++;
+			double bytes = static_cast<double>(words) * 4;
+			printf("  %-8s %10.3f ms  %6.2f GB/s%s\n",
+			       KernelNames[k], best, bytes / best / 1e6,
+			       same ? "" : "  MISMATCH");
+		}
+
+		printf("  words of class");
+		for (int c = 0; c < MIPS::WordClassCount; c++)
+			printf(" %s %zu", ClassNames[c],
+			       countBits(reference[c]));
+		printf("\n");
+	}
+
+	return mismatches ? 2 : 0;
+}
+
+static const char *const ScanKernelNames[] = {"scalar", "sse2", "avx2"};
+
+// Wildcard fields a pattern word may have: rt, rs, the immediate and the
+// three registers of a SPECIAL instruction
+static const uint32_t ScanWildcards[] = {0x001F0000, 0x03E00000, 0x0000FFFF,
+					 0x03FFF800};
+
+// Up to 8 words at a random offset of 'ram'. Half of the words get a
+// wildcard field where the image has a non-zero value so they still match
+// where they were cut out.
+static std::vector<MIPS::MaskPair> scanPattern(const std::vector<uint32_t> &ram,
+					       std::mt19937 &rng)
+{
+	size_t size = 1 + rng() % 8;
+	size_t at = ram.size() > size ? rng() % (ram.size() - size + 1) : 0;
+	std::vector<MIPS::MaskPair> pattern;
+	for (size_t i = 0; i < size; i++) {
+		uint32_t word = at + i < ram.size()
+					? ram[at + i]
+					: static_cast<uint32_t>(rng());
+		uint32_t mask = ScanWildcards[rng() % 4];
+		if (rng() % 2 || 0 == (word & mask))
+			mask = 0;
+		pattern.push_back({word & ~mask, mask});
+	}
+	return pattern;
+}
+
+// Words from a small vocabulary so patterns cut out of the image repeat
+static std::vector<uint32_t> randomImage(size_t size, std::mt19937 &rng)
+{
+	uint32_t vocabulary[64];
+	for (auto &word : vocabulary)
+		word = rng() & 0xFC1FFFFF;
+
+	std::vector<uint32_t> ram(size);
+	for (auto &word : ram)
+		word = vocabulary[rng() % 64] | ((rng() % 4) << 21);
+	return ram;
+}
+
+static double timeScan(const std::vector<uint32_t> &ram,
+		       const std::vector<MIPS::MaskPair> &pattern,
+		       MIPS::ScanKernel kernel, int repeat,
+		       std::vector<int> &indices)
+{
+	double best = 0;
+	for (int i = 0; i < repeat; i++) {
+		auto start = std::chrono::steady_clock::now();
+		indices = MIPS::IndicesOf(ram, pattern.data(), pattern.size(),
+					  kernel);
+		std::chrono::duration<double, std::milli> elapsed =
+			std::chrono::steady_clock::now() - start;
+		best = i == 0 ? elapsed.count()
+			      : std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+// Signature matches of 'count' patterns with 'kernel' that differ from
+// their references
+static size_t
+matchScan(const std::vector<uint32_t> &ram,
+	  const std::vector<std::vector<MIPS::MaskPair>> &patterns,
+	  const std::vector<std::vector<int>> &references, size_t count,
+	  MIPS::ScanKernel kernel, int repeat, double &ms)
+{
+	MIPS::SignatureMatcher matcher;
+	for (size_t p = 0; p < count; p++)
+		matcher.add(patterns[p].data(), patterns[p].size());
+
+	std::vector<std::vector<int>> matches;
+	double best = 0;
+	for (int i = 0; i < repeat; i++) {
+		auto start = std::chrono::steady_clock::now();
+		matches = matcher.match(ram, true, kernel);
+		std::chrono::duration<double, std::milli> elapsed =
+			std::chrono::steady_clock::now() - start;
+		best = i == 0 ? elapsed.count()
+			      : std::min(best, elapsed.count());
+	}
+	ms += best;
+
+	size_t mismatches = 0;
+	for (size_t p = 0; p < count; p++) {
+		if (matches[p] != references[p])
+			mismatches++;
+	}
+	return mismatches;
+}
+
+static int scan(const Options &options)
+{
+	const int PatternsPerImage = 32;
+	const int PrefilteredPatterns = 4;
+	std::mt19937 rng(options.seed);
+	std::vector<std::vector<uint32_t>> images;
+	for (size_t size = 0; size < 12; size++)
+		images.push_back(randomImage(size, rng));
+	for (size_t tail = 0; tail < 34; tail++)
+		images.push_back(randomImage(0x1000 + tail, rng));
+	for (size_t words : {0x100000u, 0x200000u}) {
+		SyntheticOptions synthOptions;
+		synthOptions.words = words;
+		images.push_back(
+			GenerateSyntheticRAM(options.seed, synthOptions).ram);
+	}
+
+	size_t mismatches = 0;
+	size_t patterns = 0;
+	size_t found = 0;
+	double ms[3]{};
+	double fewMs[3]{};
+	double allMs[3]{};
+	for (const auto &ram : images) {
+		std::vector<std::vector<MIPS::MaskPair>> patternsOfImage;
+		std::vector<std::vector<int>> references;
+		for (int p = 0; p < PatternsPerImage; p++) {
+			std::vector<MIPS::MaskPair> pattern =
+				scanPattern(ram, rng);
+			std::vector<uint32_t> words;
+			for (const auto &word : pattern)
+				words.push_back(word.val);
+			bool exact = std::all_of(
+				pattern.begin(), pattern.end(),
+				[](const MIPS::MaskPair &word) {
+					return word.mask == 0;
+				});
+
+			std::vector<int> reference = MIPS::IndicesOf(
+				ram, pattern.data(), pattern.size(),
+				MIPS::SCAN_KERNEL_SCALAR);
+			patterns++;
+			found += reference.size();
+			patternsOfImage.push_back(pattern);
+			references.push_back(reference);
+			for (int k = MIPS::SCAN_KERNEL_SCALAR;
+			     k <= MIPS::BestScanKernel(); k++) {
+				auto kernel = static_cast<MIPS::ScanKernel>(k);
+				std::vector<int> indices;
+				double best = timeScan(ram, pattern, kernel,
+						       options.repeat, indices);
+				ms[k] += best;
+				if (indices != reference)
+					mismatches++;
+				// Plain words go through the other overload
+				if (exact && MIPS::IndicesOf(ram, words.data(),
+							     words.size(),
+							     kernel) !=
+						     reference)
+					mismatches++;
+			}
+		}
+
+		for (int k = MIPS::SCAN_KERNEL_SCALAR;
+		     k <= MIPS::BestScanKernel(); k++) {
+			auto kernel = static_cast<MIPS::ScanKernel>(k);
+			mismatches += matchScan(ram, patternsOfImage,
+						references,
+						PrefilteredPatterns, kernel,
+						options.repeat, fewMs[k]);
+			mismatches += matchScan(ram, patternsOfImage,
+						references, PatternsPerImage,
+						kernel, options.repeat,
+						allMs[k]);
+		}
+	}
+
+	printf("%zu images, %zu patterns, %zu matches, best of %d\n",
+	       images.size(), patterns, found, options.repeat);
+	printf("  kernel     IndicesOf   %d signatures  %d signatures\n",
+	       PrefilteredPatterns, PatternsPerImage);
+	for (int k = MIPS::SCAN_KERNEL_SCALAR; k <= MIPS::BestScanKernel();
+	     k++)
+		printf("  %-8s %10.3f ms %10.3f ms %10.3f ms\n",
+		       ScanKernelNames[k], ms[k], fewMs[k], allMs[k]);
+	printf("%zu searches differ from the scalar kernel\n", mismatches);
+	return mismatches ? 2 : 0;
+}
+
+// Expected value of a register at the JAL of a window, nothing if it must
+// not be known
+struct ExpectedRegister {
+	MIPS::Register reg;
+	std::optional<MIPS::KnownValue> value;
+};
+
+// A hand-assembled window that ends with a JAL and its delay slot. Every
+// window starts after a 'JR RA' and its delay slot, so it is propagated from
+// word 2 on.
+struct DataflowWindow {
+	const char *name;
+	std::vector<MIPS::MaskPair> code;
+	std::optional<uint32_t> gp;
+	std::vector<ExpectedRegister> regs;
+	std::vector<MIPS::KnownValue> stored;
+};
+
+static std::vector<DataflowWindow> dataflowWindows()
+{
+	using namespace MIPS;
+	const Confidence Exact = CONFIDENCE_EXACT;
+	const Confidence Assumed = CONFIDENCE_ASSUMED;
+	const std::optional<KnownValue> None;
+	auto addiu = [](Register rt, Register rs, int val) {
+		return Asm(CMD_ADDIU).rt(rt).rs(rs).imm(val);
+	};
+	auto lui = [](Register rt, int val) {
+		return Asm(CMD_LUI).rt(rt).imm(val);
+	};
+	// Loads and stores take the immediate in bytes here
+	auto memory = [](Cmd cmd, Register rt, int val, Register base) {
+		return Asm(cmd).rt(rt).rs(base).off(val * 4);
+	};
+	auto branch = [](Cmd cmd, Register rs, Register rt, int words) {
+		return Asm(cmd).rs(rs).rt(rt).off(words * 4);
+	};
+	const MaskPair nop = Asm(CMD_NOP);
+	const MaskPair jrRA = Asm(CMD_JR).rs(REG_RA);
+	const MaskPair call = Asm(CMD_JAL).jump(0x80000400);
+
+	return {
+		{"straight line",
+		 {jrRA, nop, lui(REG_A0, 0x8033),
+		  addiu(REG_A0, REG_A0, 0x1234),
+		  Asm(CMD_ORI).rt(REG_A1).rs(REG_R0).imm(4), call,
+		  addiu(REG_A2, REG_R0, 7)},
+		 std::nullopt,
+		 {{REG_A0, KnownValue{0x80331234, Exact}},
+		  {REG_A1, KnownValue{4, Exact}},
+		  {REG_A2, KnownValue{7, Exact}},
+		  {REG_A3, None}},
+		 {}},
+		// BEQ skips word 5, the delay slot runs on both paths
+		{"forward branch",
+		 {jrRA, nop, addiu(REG_A0, REG_R0, 1),
+		  addiu(REG_A3, REG_R0, 9),
+		  branch(CMD_BEQ, REG_A1, REG_R0, 2),
+		  addiu(REG_A1, REG_R0, 5), addiu(REG_A0, REG_R0, 2),
+		  addiu(REG_A2, REG_R0, 3), call, nop},
+		 std::nullopt,
+		 {{REG_A0, None},
+		  {REG_A1, KnownValue{5, Exact}},
+		  {REG_A2, KnownValue{3, Exact}},
+		  {REG_A3, KnownValue{9, Exact}}},
+		 {}},
+		// The first store is skipped when BNE is taken
+		{"skipped store",
+		 {jrRA, nop, addiu(REG_A0, REG_R0, 1),
+		  branch(CMD_BNE, REG_A1, REG_R0, 2), nop,
+		  memory(CMD_SW, REG_A0, 0x10, REG_SP),
+		  memory(CMD_SW, REG_A0, 0x14, REG_SP),
+		  memory(CMD_LW, REG_A2, 0x10, REG_SP),
+		  memory(CMD_LW, REG_A3, 0x14, REG_SP), call, nop},
+		 std::nullopt,
+		 {{REG_A0, KnownValue{1, Exact}},
+		  {REG_A2, None},
+		  {REG_A3, KnownValue{1, Exact}}},
+		 {{1, Assumed}, {1, Exact}}},
+		// The delay slot of BEQL only runs when it is taken
+		{"likely delay slot",
+		 {jrRA, nop, addiu(REG_A1, REG_R0, 1),
+		  addiu(REG_A3, REG_R0, 6),
+		  branch(CMD_BEQL, REG_A0, REG_R0, 2),
+		  memory(CMD_SW, REG_A1, 0x10, REG_SP),
+		  addiu(REG_A3, REG_R0, 8), addiu(REG_A2, REG_R0, 4),
+		  memory(CMD_LW, REG_T0, 0x10, REG_SP), call, nop},
+		 std::nullopt,
+		 {{REG_A1, KnownValue{1, Exact}},
+		  {REG_A2, KnownValue{4, Exact}},
+		  {REG_A3, None},
+		  {REG_T0, None}},
+		 {{1, Assumed}}},
+		// Counts A0 down from 0x10, the loop is followed once
+		{"loop",
+		 {jrRA, nop, addiu(REG_A0, REG_R0, 0x10),
+		  addiu(REG_A0, REG_A0, -1),
+		  branch(CMD_BNE, REG_A0, REG_R0, -2), nop,
+		  addiu(REG_A1, REG_R0, 3), call, nop},
+		 std::nullopt,
+		 {{REG_A0, KnownValue{0xF, Assumed}},
+		  {REG_A1, KnownValue{3, Assumed}}},
+		 {}},
+		// BNE jumps back past the start of the window, so it still
+		// closes a loop
+		{"loop before start",
+		 {jrRA, nop, addiu(REG_A0, REG_R0, 5),
+		  branch(CMD_BNE, REG_A1, REG_R0, -3), nop,
+		  addiu(REG_A1, REG_R0, 3), call, nop},
+		 std::nullopt,
+		 {{REG_A0, KnownValue{5, Assumed}},
+		  {REG_A1, KnownValue{3, Assumed}}},
+		 {}},
+		// The first JAL keeps S0 and the stack but not A0, A1 or the
+		// store to 0x80300000
+		{"earlier call",
+		 {jrRA, nop, addiu(REG_S0, REG_R0, 0x20),
+		  addiu(REG_A0, REG_R0, 1),
+		  memory(CMD_SW, REG_A0, 0x10, REG_SP), lui(REG_T0, 0x8030),
+		  memory(CMD_SW, REG_A0, 0, REG_T0), call,
+		  addiu(REG_A1, REG_R0, 2),
+		  memory(CMD_LW, REG_A2, 0x10, REG_SP), lui(REG_T1, 0x8030),
+		  memory(CMD_LW, REG_A3, 0, REG_T1), call, nop},
+		 std::nullopt,
+		 {{REG_S0, KnownValue{0x20, Exact}},
+		  {REG_A0, None},
+		  {REG_A1, None},
+		  {REG_A2, KnownValue{1, Exact}},
+		  {REG_A3, None},
+		  {REG_T1, KnownValue{0x80300000, Exact}}},
+		 {{1, Exact}, {1, Exact}}},
+		// SH to the second word of the frame forgets what SW put there
+		{"stack spills",
+		 {jrRA, nop, addiu(REG_SP, REG_SP, -0x20),
+		  lui(REG_T0, 0x8034), addiu(REG_T0, REG_T0, 0x5678),
+		  memory(CMD_SW, REG_T0, 0x18, REG_SP),
+		  memory(CMD_SW, REG_R0, 0x1C, REG_SP),
+		  addiu(REG_T0, REG_R0, 0),
+		  memory(CMD_LW, REG_A0, 0x18, REG_SP),
+		  memory(CMD_SH, REG_R0, 0x1E, REG_SP),
+		  memory(CMD_LW, REG_A1, 0x1C, REG_SP),
+		  addiu(REG_A2, REG_SP, 0x18), call, nop},
+		 std::nullopt,
+		 {{REG_A0, KnownValue{0x80345678, Exact}},
+		  {REG_A1, None},
+		  {REG_A2, None},
+		  {REG_T0, KnownValue{0, Exact}},
+		  {REG_SP, None}},
+		 {{0x80345678, Exact}, {0, Exact}}},
+		{"gp relative",
+		 {jrRA, nop, addiu(REG_A0, REG_GP, -0x7FF0),
+		  addiu(REG_T0, REG_R0, 4),
+		  memory(CMD_SW, REG_T0, -0x7FEC, REG_GP),
+		  memory(CMD_LW, REG_A1, -0x7FEC, REG_GP), call, nop},
+		 0x80300000,
+		 {{REG_A0, KnownValue{0x802F8010, Assumed}},
+		  {REG_A1, KnownValue{4, Assumed}},
+		  {REG_GP, KnownValue{0x80300000, Assumed}}},
+		 {{4, Exact}}},
+		// Same code without GP, nothing it addresses is known
+		{"gp unknown",
+		 {jrRA, nop, addiu(REG_A0, REG_GP, -0x7FF0),
+		  addiu(REG_T0, REG_R0, 4),
+		  memory(CMD_SW, REG_T0, -0x7FEC, REG_GP),
+		  memory(CMD_LW, REG_A1, -0x7FEC, REG_GP), call, nop},
+		 std::nullopt,
+		 {{REG_A0, None}, {REG_A1, None}, {REG_GP, None}},
+		 {{4, Exact}}},
+	};
+}
+
+static std::string knownValueText(const std::optional<MIPS::KnownValue> &value)
+{
+	if (!value)
+		return "unknown";
+
+	char text[32];
+	snprintf(text, sizeof(text), "%08x %s", value->value,
+		 confidenceName(value->confidence));
+	return text;
+}
+
+static bool sameKnownValue(const std::optional<MIPS::KnownValue> &a,
+			   const std::optional<MIPS::KnownValue> &b)
+{
+	if (!a || !b)
+		return !a && !b;
+
+	return a->value == b->value && a->confidence == b->confidence;
+}
+
+// Prints every way the state at the JAL of 'window' differs from what it
+// expects, returns whether it did
+static bool checkDataflow(const DataflowWindow &window)
+{
+	bool differs = false;
+	std::vector<uint32_t> mem;
+	for (const auto &word : window.code) {
+		// Every field has to be given
+		if (word.mask != 0) {
+			printf("%s: word %zu has wildcards\n", window.name,
+			       mem.size());
+			differs = true;
+		}
+		mem.push_back(word.val);
+	}
+
+	MIPS::CallState state;
+	int jal = static_cast<int>(mem.size()) - 2;
+	MIPS::PropagateToCall(mem, jal, 64, window.gp, state);
+	if (state.start != 2) {
+		printf("%s: starts at word %d\n", window.name, state.start);
+		differs = true;
+	}
+
+	for (const auto &expected : window.regs) {
+		const auto &value = state.regs[expected.reg];
+		if (sameKnownValue(value, expected.value))
+			continue;
+
+		printf("%s: register %d is %s, not %s\n", window.name,
+		       static_cast<int>(expected.reg),
+		       knownValueText(value).c_str(),
+		       knownValueText(expected.value).c_str());
+		differs = true;
+	}
+
+	bool sameStores = state.stored.size() == window.stored.size();
+	for (size_t i = 0; sameStores && i < state.stored.size(); i++)
+		sameStores = sameKnownValue(state.stored[i], window.stored[i]);
+	if (!sameStores) {
+		printf("%s: stored", window.name);
+		for (const auto &stored : state.stored)
+			printf(" %s", knownValueText(stored).c_str());
+		printf(", not");
+		for (const auto &stored : window.stored)
+			printf(" %s", knownValueText(stored).c_str());
+		printf("\n");
+		differs = true;
+	}
+
+	return differs;
+}
+
+static int dataflow()
+{
+	std::vector<DataflowWindow> windows = dataflowWindows();
+	size_t failed = 0;
+	for (const auto &window : windows) {
+		if (checkDataflow(window))
+			failed++;
+	}
+
+	printf("%zu of %zu windows differ from their expected state\n",
+	       failed, windows.size());
+	return failed ? 2 : 0;
+}
+
+// Whether 'decodeCmd' agrees with the full decoders on 'word'
+static bool decodesAlike(uint32_t word)
+{
+	std::optional<MIPS::PackedInstruction> packed =
+		MIPS::decodePacked(word);
+	std::optional<MIPS::Instruction> inst = MIPS::decodeInstruction(word);
+	uint32_t cmd = MIPS::decodeCmd(word);
+	if (!packed)
+		return cmd == MIPS::CmdCount && !inst;
+
+	return cmd == static_cast<uint32_t>(packed->cmd()) && inst &&
+	       cmd == static_cast<uint32_t>(inst->cmd);
+}
+
+static int decode(const Options &options)
+{
+	const uint32_t FieldCombinations = 1u << 22;
+	std::mt19937 rng(options.seed);
+	size_t words = 0;
+	size_t decoded = 0;
+	size_t mismatches = 0;
+	auto check = [&](uint32_t word) {
+		words++;
+		if (MIPS::decodeCmd(word) != MIPS::CmdCount)
+			decoded++;
+		if (decodesAlike(word))
+			return;
+		if (mismatches++ < 8)
+			printf("  %08x decodes to %u, %s\n", word,
+			       MIPS::decodeCmd(word),
+			       MIPS::decodePacked(word) ? "not its Cmd"
+							: "not CmdCount");
+	};
+
+	// opcode, rs and rt are the top 16 bits, funct the bottom 6
+	check(0);
+	for (uint32_t fields = 0; fields < FieldCombinations; fields++) {
+		uint32_t middle = rng() & 0xFFC0;
+		check(((fields >> 6) << 16) | middle | (fields & 0x3F));
+	}
+	for (uint32_t i = 0; i < FieldCombinations; i++)
+		check(static_cast<uint32_t>(rng()));
+
+	printf("%zu words, %zu of them decoded\n", words, decoded);
+	printf("%zu words decode differently with decodeCmd\n", mismatches);
+	return mismatches ? 2 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		if (0 == strcmp(argv[i], "--bench")) {
+			options.bench = true;
+		} else if (0 == strcmp(argv[i], "--serial")) {
+			options.analyze.serial = true;
+		} else if (0 == strcmp(argv[i], "--repeat") && i + 1 < argc) {
+			options.repeat = std::max(1, atoi(argv[++i]));
+		} else if (0 == strcmp(argv[i], "--synth") && i + 1 < argc) {
+			options.synth = std::max(1, atoi(argv[++i]));
+		} else if (0 == strcmp(argv[i], "--faults") && i + 1 < argc) {
+			options.faults = std::max(1, atoi(argv[++i]));
+		} else if (0 == strcmp(argv[i], "--classify")) {
+			options.classify = true;
+		} else if (0 == strcmp(argv[i], "--scan")) {
+			options.scan = true;
+		} else if (0 == strcmp(argv[i], "--decode")) {
+			options.decode = true;
+		} else if (0 == strcmp(argv[i], "--dataflow")) {
+			options.dataflow = true;
+		} else if (0 == strcmp(argv[i], "--seed") && i + 1 < argc) {
+			options.seed = static_cast<uint32_t>(
+				strtoul(argv[++i], nullptr, 0));
+		} else if (0 == strcmp(argv[i], "--expansion")) {
+			options.expansion = true;
+		} else if (0 == strcmp(argv[i], "--write") && i + 1 < argc) {
+			options.write = argv[++i];
+		} else if (0 == strcmp(argv[i], "--signatures") &&
+			   i + 1 < argc) {
+			options.signatures.push_back(argv[++i]);
+		} else if (argv[i][0] == '-') {
+			usage();
+			return 1;
+		} else {
+			options.paths.push_back(argv[i]);
+		}
+	}
+
+	MIPS::SignatureDatabase signatures;
+	if (!options.signatures.empty()) {
+		if (!loadSignatures(options.signatures, signatures))
+			return 1;
+		options.analyze.signatures = &signatures;
+	}
+
+	if (options.dataflow) {
+		if (options.decode || options.scan || options.classify ||
+		    options.faults || options.synth || options.bench ||
+		    !options.paths.empty()) {
+			usage();
+			return 1;
+		}
+		return dataflow();
+	}
+
+	if (options.decode) {
+		if (options.scan || options.classify || options.faults ||
+		    options.synth || options.bench || !options.paths.empty()) {
+			usage();
+			return 1;
+		}
+		return decode(options);
+	}
+
+	if (options.scan) {
+		if (options.classify || options.faults || options.synth ||
+		    options.bench || !options.paths.empty()) {
+			usage();
+			return 1;
+		}
+		return scan(options);
+	}
+
+	if (options.classify) {
+		if (options.faults || options.synth || options.bench ||
+		    !options.paths.empty()) {
+			usage();
+			return 1;
+		}
+		return classify(options);
+	}
+
+	if (options.faults) {
+		if (options.synth || options.bench || !options.paths.empty()) {
+			usage();
+			return 1;
+		}
+		return faults(options);
+	}
+
+	if (options.synth) {
+		if (options.bench || !options.paths.empty()) {
+			usage();
+			return 1;
+		}
+		return synth(options);
+	}
+
+	if (options.paths.empty() ||
+	    (options.bench && options.paths.size() != 1)) {
+		usage();
+		return 1;
+	}
+
+	if (options.bench)
+		return bench(options.paths[0], options);
+
+	int ret = 0;
+	for (const auto &path : options.paths)
+		ret = std::max(ret, analyzeDump(path, options));
+
+	return ret;
+}
@@ -0,0 +1,904 @@
+#include "synthetic_ram.h"
+
+#include "mips_converter.h"
+#include "mips_instruction.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+using namespace MIPS;
+
+// Everything below is encoded with 'ToUInt', helpers only fill the fields
+// the format of the command needs
+static Instruction nop()
+{
+	Instruction inst{};
+	inst.cmd = CMD_NOP;
+	return inst;
+}
+
+static Instruction reg(Cmd cmd, Register rd, Register rs, Register rt)
+{
+	Instruction inst{};
+	inst.cmd = cmd;
+	inst.rd = rd;
+	inst.rs = rs;
+	inst.rt = rt;
+	return inst;
+}
+
+static Instruction shift(Cmd cmd, Register rd, Register rt, int sa)
+{
+	Instruction inst{};
+	inst.cmd = cmd;
+	inst.rd = rd;
+	inst.rt = rt;
+	inst.shift = sa;
+	return inst;
+}
+
+static Instruction imm(Cmd cmd, Register rt, Register rs, int val)
+{
+	Instruction inst{};
+	inst.cmd = cmd;
+	inst.rt = rt;
+	inst.rs = rs;
+	inst.imm = static_cast<short>(val);
+	return inst;
+}
+
+static Instruction lui(Register rt, uint32_t val)
+{
+	Instruction inst{};
+	inst.cmd = CMD_LUI;
+	inst.rt = rt;
+	inst.imm = static_cast<short>(val & 0xffff);
+	return inst;
+}
+
+// 'Instruction::off' is the immediate shifted left by 2 for loads and
+// stores too, 'ToUInt' shifts it back
+static Instruction mem(Cmd cmd, Register rt, int val, Register base)
+{
+	Instruction inst{};
+	inst.cmd = cmd;
+	inst.rt = rt;
+	inst.rs = base;
+	inst.off = static_cast<int>(static_cast<short>(val)) * 4;
+	return inst;
+}
+
+static Instruction branch(Cmd cmd, Register rs, Register rt, int words)
+{
+	Instruction inst{};
+	inst.cmd = cmd;
+	inst.rs = rs;
+	inst.rt = rt;
+	inst.off = words * 4;
+	return inst;
+}
+
+static Instruction jal(size_t target)
+{
+	Instruction inst{};
+	inst.cmd = CMD_JAL;
+	inst.jump = static_cast<uint32_t>(target) << 2;
+	return inst;
+}
+
+static Instruction jr(Register rs)
+{
+	Instruction inst{};
+	inst.cmd = CMD_JR;
+	inst.rs = rs;
+	return inst;
+}
+
+static Instruction cop0(Cmd cmd, Register rt, Cop0Registers cop0)
+{
+	Instruction inst{};
+	inst.cmd = cmd;
+	inst.rt = rt;
+	inst.cop0 = cop0;
+	return inst;
+}
+
+static Instruction cache(int op, Register base, int val)
+{
+	Instruction inst{};
+	inst.cmd = CMD_CACHE;
+	inst.cache = static_cast<CacheOp>(op);
+	inst.rs = base;
+	inst.off = val * 4;
+	return inst;
+}
+
+// %hi/%lo pair as the compiler splits addresses for LUI + ADDIU
+static uint32_t hi(uint32_t addr)
+{
+	return (addr + 0x8000) >> 16;
+}
+
+static int lo(uint32_t addr)
+{
+	return static_cast<short>(addr & 0xffff);
+}
+
+static const Register sFillerRegisters[] = {
+	REG_V0, REG_V1, REG_A0, REG_A1, REG_A2, REG_A3, REG_T0, REG_T1,
+	REG_T2, REG_T3, REG_T4, REG_T5, REG_T6, REG_T7, REG_T8, REG_T9,
+	REG_S0, REG_S1, REG_S2, REG_S3, REG_S4, REG_S5, REG_S6, REG_S7,
+};
+
+static const Cmd sFillerAlu[] = {CMD_ADDU, CMD_SUBU, CMD_AND, CMD_OR,
+				 CMD_XOR,  CMD_SLT,  CMD_SLTU};
+static const Cmd sFillerAluImm[] = {CMD_ADDIU, CMD_ANDI, CMD_ORI, CMD_SLTI};
+static const Cmd sFillerLoads[] = {CMD_LW, CMD_LH, CMD_LHU, CMD_LBU};
+static const Cmd sFillerStores[] = {CMD_SW, CMD_SH, CMD_SB};
+static const Cmd sFillerShifts[] = {CMD_SLL, CMD_SRL, CMD_SRA};
+
+// Upper bound of a generated function, used to keep them inside segments
+static const size_t MaxFunctionWords = 0x100;
+
+class Generator {
+public:
+	Generator(uint32_t seed, const SyntheticOptions &options)
+		: rng_(seed), ram_(options.words)
+	{
+		if (options.words != 0x100000 && options.words != 0x200000)
+			throw std::invalid_argument("RDRAM is 4 or 8 MB");
+	}
+
+	SyntheticRAM generate();
+
+private:
+	enum Planted {
+		PLANTED_OS_GET_COUNT,
+		PLANTED_OS_DISABLE_INT,
+		PLANTED_OS_RESTORE_INT,
+		PLANTED_OS_WRITEBACK_DCACHE,
+		PLANTED_OS_INVAL_DCACHE,
+		PLANTED_OS_VIRTUAL_TO_PHYSICAL,
+		PLANTED_OS_GET_TIME,
+		PLANTED_OS_SI_RAW_START_DMA,
+		PLANTED_OS_CONT_INIT,
+		PLANTED_GPR_SETUP,
+		PLANTED_CONTROLLER_INIT,
+		PLANTED_VI_MGR_MAIN,
+		PLANTED_COUNT,
+	};
+
+	struct Segment {
+		size_t begin;
+		size_t end;
+	};
+
+	// Raw engine output so images do not depend on the standard library
+	uint32_t below(uint32_t n)
+	{
+		return static_cast<uint32_t>(rng_()) % n;
+	}
+	bool chance(uint32_t percent) { return below(100) < percent; }
+
+	template<typename T, size_t N> T pick(const T (&values)[N])
+	{
+		return values[below(N)];
+	}
+
+	Register anyRegister() { return pick(sFillerRegisters); }
+
+	void emit(const Instruction &inst) { ram_[cursor_++] = ToUInt(inst); }
+
+	// Targets are patched in once every function has been placed
+	void call(size_t function)
+	{
+		calls_.push_back({cursor_, function});
+		emit(nop());
+	}
+
+	void begin(size_t function) { starts_[function] = cursor_; }
+
+	uint32_t dataAddress(size_t reserveWords);
+	void fillVectors();
+	void fillData();
+	void fillControllerData();
+	void fillText(const Segment &segment, std::vector<Planted> planted);
+	void emitFiller();
+	void emitFillerOp(bool leaf, int frame, bool branches = true);
+	void emitPlanted(Planted planted);
+	void emitDisableInt();
+	void emitWritebackDCache();
+	void emitInvalDCache();
+	void emitGetTime();
+	void emitSiRawStartDma();
+	void emitContInit();
+	void emitControllerInit();
+	void emitViMgrMain();
+
+	std::mt19937 rng_;
+	std::vector<uint32_t> ram_;
+	std::vector<Segment> text_;
+	size_t cursor_ = 0;
+
+	// Function starts, planted ones first then filler in emission order
+	std::vector<size_t> starts_ = std::vector<size_t>(PLANTED_COUNT);
+	std::vector<std::pair<size_t, size_t>> calls_;
+
+	uint32_t gControllerPads_ = 0;
+	uint32_t controllerStatus_ = 0;
+	uint32_t controllerQueue_ = 0;
+	uint32_t osContPifRam_ = 0;
+	uint32_t gp_ = 0;
+	uint32_t viIntrCount_ = 0;
+	int osContInitCall_ = -1;
+};
+
+// Random word aligned address outside of code with room for 'reserveWords'
+uint32_t Generator::dataAddress(size_t reserveWords)
+{
+	for (;;) {
+		size_t range = ram_.size() - text_[0].end - reserveWords;
+		size_t off = text_[0].end +
+			     below(static_cast<uint32_t>(range));
+		bool inText = false;
+		for (const auto &segment : text_) {
+			if (off + reserveWords > segment.begin &&
+			    off < segment.end)
+				inText = true;
+		}
+
+		if (!inText)
+			return 0x80000000u | static_cast<uint32_t>(off << 2);
+	}
+}
+
+// General exception vectors jump to the handler through K0, the first word
+// doubles as the magic 'Emulator' searches for
+void Generator::fillVectors()
+{
+	const uint32_t handler = 0x80000000u | (0x80 << 2);
+	for (size_t vector = 0; vector < 0x80; vector += 0x20) {
+		cursor_ = vector;
+		emit(lui(REG_K0, hi(handler)));
+		emit(imm(CMD_ADDIU, REG_K0, REG_K0, lo(handler)));
+		emit(jr(REG_K0));
+		emit(nop());
+	}
+}
+
+// Runs of BSS zeros, small integers, pointers and floats
+void Generator::fillData()
+{
+	size_t off = text_[0].end;
+	while (off < ram_.size()) {
+		size_t run = std::min<size_t>(16 + below(1024),
+					      ram_.size() - off);
+		uint32_t kind = below(4);
+		for (size_t i = 0; i < run; i++, off++) {
+			bool inText = false;
+			for (const auto &segment : text_) {
+				if (off >= segment.begin && off < segment.end)
+					inText = true;
+			}
+			if (inText)
+				continue;
+
+			switch (kind) {
+			case 0:
+				ram_[off] = 0;
+				break;
+			case 1:
+				ram_[off] = below(0x1000);
+				break;
+			case 2:
+				ram_[off] = 0x80000000u |
+					    (below(static_cast<uint32_t>(
+						     ram_.size())) << 2);
+				break;
+			default:
+				ram_[off] = 0x3F800000u + below(0x01000000) -
+					    0x00800000u;
+				break;
+			}
+		}
+	}
+}
+
+// What the game left in its controller globals: controller 1 plugged in and
+// the others not responding, the message queue osContInit was given empty
+void Generator::fillControllerData()
+{
+	auto word = [&](uint32_t addr, size_t i) -> uint32_t & {
+		return ram_[((addr & 0xffffff) >> 2) + i];
+	};
+
+	// OSContPad is 6 bytes: button, stick_x, stick_y, errno and padding
+	uint32_t buttons = below(0x10000) & ~0x00c0u;
+	const uint32_t pads[] = {buttons << 16 | below(0x10000),
+				 0,
+				 0x00000800,
+				 0,
+				 0x08000000,
+				 0x00000800};
+	for (size_t i = 0; i < 6; i++)
+		word(gControllerPads_, i) = pads[i];
+
+	// OSContStatus is type, status and errno
+	const uint32_t status[] = {0x00050000, 0x00000008, 0x00000008,
+				   0x00000008};
+	for (size_t i = 0; i < 4; i++)
+		word(controllerStatus_, i) = status[i];
+
+	// OSMesgQueue: both thread queues at the thread tail, validCount,
+	// first, msgCount and the message buffer
+	uint32_t threadTail = dataAddress(2);
+	const uint32_t queue[] = {threadTail, threadTail, 0, 0,
+				  1,          dataAddress(1)};
+	for (size_t i = 0; i < 6; i++)
+		word(controllerQueue_, i) = queue[i];
+}
+
+void Generator::fillText(const Segment &segment, std::vector<Planted> planted)
+{
+	for (size_t i = planted.size(); i > 1; i--)
+		std::swap(planted[i - 1],
+			  planted[below(static_cast<uint32_t>(i))]);
+
+	// Leaves room for all of them at the end of the segment
+	size_t range = segment.end - segment.begin - 4 * MaxFunctionWords;
+	std::vector<size_t> at;
+	for (size_t i = 0; i < planted.size(); i++)
+		at.push_back(segment.begin +
+			     below(static_cast<uint32_t>(range)));
+	std::sort(at.begin(), at.end());
+
+	cursor_ = segment.begin;
+	size_t next = 0;
+	while (cursor_ + MaxFunctionWords < segment.end) {
+		if (next < planted.size() && cursor_ >= at[next]) {
+			emitPlanted(planted[next++]);
+		} else {
+			emitFiller();
+		}
+
+		// Functions are 8 or 16 byte aligned
+		size_t align = chance(50) ? 2 : 4;
+		while (cursor_ % align)
+			emit(nop());
+	}
+
+	if (next != planted.size() || cursor_ > segment.end)
+		throw std::logic_error("text segment overflow");
+}
+
+void Generator::emitFiller()
+{
+	starts_.push_back(cursor_);
+	bool leaf = chance(30);
+	int frame = 0x18 + 8 * static_cast<int>(below(10));
+	if (!leaf) {
+		emit(imm(CMD_ADDIU, REG_SP, REG_SP, -frame));
+		emit(mem(CMD_SW, REG_RA, frame - 4, REG_SP));
+	}
+
+	// libultra is called from everywhere, these calls should not confuse
+	// the analyzer
+	if (!leaf && chance(4)) {
+		call(PLANTED_OS_DISABLE_INT);
+		emit(nop());
+		emit(reg(CMD_OR, REG_S0, REG_V0, REG_R0));
+		for (uint32_t i = below(6); i; i--)
+			emitFillerOp(true, frame);
+		call(PLANTED_OS_RESTORE_INT);
+		emit(reg(CMD_OR, REG_A0, REG_S0, REG_R0));
+	} else if (!leaf && chance(1)) {
+		call(PLANTED_OS_GET_TIME);
+		emit(nop());
+	} else if (!leaf && chance(1)) {
+		call(PLANTED_OS_SI_RAW_START_DMA);
+		emit(imm(CMD_ADDIU, REG_A0, REG_R0, 1));
+	}
+
+	for (uint32_t i = 4 + below(120); i; i--)
+		emitFillerOp(leaf, frame);
+
+	if (!leaf)
+		emit(mem(CMD_LW, REG_RA, frame - 4, REG_SP));
+	emit(jr(REG_RA));
+	if (!leaf)
+		emit(imm(CMD_ADDIU, REG_SP, REG_SP, frame));
+	else
+		emit(nop());
+}
+
+void Generator::emitFillerOp(bool leaf, int frame, bool branches)
+{
+	uint32_t op = below(100);
+	if (op < 25) {
+		emit(reg(pick(sFillerAlu), anyRegister(), anyRegister(),
+			 anyRegister()));
+	} else if (op < 40) {
+		emit(imm(pick(sFillerAluImm), anyRegister(), anyRegister(),
+			 static_cast<int>(below(0x200))));
+	} else if (op < 48) {
+		emit(lui(anyRegister(), 0x8000 + below(0x80)));
+	} else if (op < 63) {
+		if (!leaf && chance(50))
+			emit(mem(pick(sFillerLoads), anyRegister(),
+				 static_cast<int>(below(frame / 4)) * 4,
+				 REG_SP));
+		else
+			emit(mem(pick(sFillerLoads), anyRegister(),
+				 static_cast<int>(below(0x100)) * 4,
+				 anyRegister()));
+	} else if (op < 75) {
+		if (!leaf && chance(50))
+			emit(mem(pick(sFillerStores), anyRegister(),
+				 static_cast<int>(below(frame / 4)) * 4,
+				 REG_SP));
+		else
+			emit(mem(pick(sFillerStores), anyRegister(),
+				 static_cast<int>(below(0x100)) * 4,
+				 anyRegister()));
+	} else if (op < 83) {
+		emit(shift(pick(sFillerShifts), anyRegister(), anyRegister(),
+			   static_cast<int>(below(32))));
+	} else if (op < 90 && !branches) {
+		emit(nop());
+	} else if (op < 90) {
+		emit(branch(chance(50) ? CMD_BEQ : CMD_BNE, anyRegister(),
+			    chance(50) ? REG_R0 : anyRegister(),
+			    1 + static_cast<int>(below(8))));
+		emit(nop());
+	} else if (op < 98 && !leaf && starts_.size() > PLANTED_COUNT + 1) {
+		// Only functions placed so far are called so every target
+		// is a function start
+		call(PLANTED_COUNT +
+		     below(static_cast<uint32_t>(starts_.size() -
+						 PLANTED_COUNT - 1)));
+		if (chance(50))
+			emit(nop());
+		else
+			emit(reg(pick(sFillerAlu), REG_A0, anyRegister(),
+				 anyRegister()));
+	} else {
+		emit(nop());
+	}
+}
+
+void Generator::emitPlanted(Planted planted)
+{
+	switch (planted) {
+	case PLANTED_OS_GET_COUNT:
+		begin(planted);
+		emit(cop0(CMD_MFC0, REG_V0, COP0_Count));
+		emit(jr(REG_RA));
+		emit(nop());
+		break;
+	case PLANTED_OS_DISABLE_INT:
+		emitDisableInt();
+		break;
+	case PLANTED_OS_RESTORE_INT:
+		begin(planted);
+		emit(cop0(CMD_MFC0, REG_T0, COP0_Status));
+		emit(reg(CMD_OR, REG_T0, REG_T0, REG_A0));
+		emit(cop0(CMD_MTC0, REG_T0, COP0_Status));
+		emit(nop());
+		emit(nop());
+		emit(jr(REG_RA));
+		emit(nop());
+		break;
+	case PLANTED_OS_WRITEBACK_DCACHE:
+		emitWritebackDCache();
+		break;
+	case PLANTED_OS_INVAL_DCACHE:
+		emitInvalDCache();
+		break;
+	case PLANTED_OS_VIRTUAL_TO_PHYSICAL:
+		begin(planted);
+		emit(lui(REG_AT, 0x1fff));
+		emit(imm(CMD_ORI, REG_AT, REG_AT, 0xffff));
+		emit(jr(REG_RA));
+		emit(reg(CMD_AND, REG_V0, REG_A0, REG_AT));
+		break;
+	case PLANTED_OS_GET_TIME:
+		emitGetTime();
+		break;
+	case PLANTED_OS_SI_RAW_START_DMA:
+		emitSiRawStartDma();
+		break;
+	case PLANTED_OS_CONT_INIT:
+		emitContInit();
+		break;
+	case PLANTED_GPR_SETUP:
+		begin(planted);
+		emit(lui(REG_GP, hi(gp_)));
+		emit(jr(REG_RA));
+		emit(imm(CMD_ADDIU, REG_GP, REG_GP, lo(gp_)));
+		break;
+	case PLANTED_CONTROLLER_INIT:
+		emitControllerInit();
+		break;
+	case PLANTED_VI_MGR_MAIN:
+		emitViMgrMain();
+		break;
+	case PLANTED_COUNT:
+		break;
+	}
+}
+
+// Newer libultra checks the global interrupt mask first, the analyzer
+// accepts the function starting 4 words before the signature
+void Generator::emitDisableInt()
+{
+	begin(PLANTED_OS_DISABLE_INT);
+	if (chance(50)) {
+		uint32_t mask = dataAddress(1);
+		emit(lui(REG_T2, hi(mask)));
+		emit(mem(CMD_LW, REG_T2, lo(mask), REG_T2));
+		emit(imm(CMD_ANDI, REG_T3, REG_T2, 0xff00));
+		emit(nop());
+	}
+
+	emit(cop0(CMD_MFC0, REG_T0, COP0_Status));
+	emit(imm(CMD_ADDIU, REG_AT, REG_R0, -2));
+	emit(reg(CMD_AND, REG_T1, REG_T0, REG_AT));
+	emit(cop0(CMD_MTC0, REG_T1, COP0_Status));
+	emit(imm(CMD_ANDI, REG_V0, REG_T0, 1));
+	emit(nop());
+	emit(jr(REG_RA));
+	emit(nop());
+}
+
+// Argument checks the analyzer skips as 13 words before the signature
+static void appendDCacheChecks(std::vector<Instruction> &code)
+{
+	code.push_back(branch(CMD_BLEZ, REG_A1, REG_R0, 0x11));
+	code.push_back(nop());
+	code.push_back(imm(CMD_ADDIU, REG_T3, REG_R0, 0x2000));
+	code.push_back(reg(CMD_SLTU, REG_AT, REG_A1, REG_T3));
+	code.push_back(branch(CMD_BEQ, REG_AT, REG_R0, 0xf));
+	code.push_back(nop());
+	code.push_back(reg(CMD_OR, REG_T0, REG_A0, REG_R0));
+	code.push_back(reg(CMD_ADDU, REG_T1, REG_A0, REG_A1));
+	code.push_back(reg(CMD_SLTU, REG_AT, REG_T0, REG_T1));
+	code.push_back(branch(CMD_BEQ, REG_AT, REG_R0, 0xb));
+	code.push_back(nop());
+	code.push_back(imm(CMD_ANDI, REG_T2, REG_T0, 0xf));
+	code.push_back(imm(CMD_ADDIU, REG_T1, REG_T1, -0x10));
+}
+
+// Writes back or invalidates the whole cache for large ranges
+static void appendDCacheWholeCache(std::vector<Instruction> &code)
+{
+	code.push_back(jr(REG_RA));
+	code.push_back(nop());
+	code.push_back(lui(REG_T0, 0x8000));
+	code.push_back(reg(CMD_ADDU, REG_T1, REG_T0, REG_T3));
+	code.push_back(imm(CMD_ADDIU, REG_T1, REG_T1, -0x10));
+	code.push_back(cache(CACHE_IIndexInvalidate | CACHE_D, REG_T0, 0));
+	code.push_back(reg(CMD_SLTU, REG_AT, REG_T0, REG_T1));
+	code.push_back(branch(CMD_BNE, REG_AT, REG_R0, -3));
+	code.push_back(imm(CMD_ADDIU, REG_T0, REG_T0, 0x10));
+	code.push_back(jr(REG_RA));
+	code.push_back(nop());
+}
+
+void Generator::emitWritebackDCache()
+{
+	std::vector<Instruction> code;
+	appendDCacheChecks(code);
+	code.push_back(reg(CMD_SUBU, REG_T0, REG_T0, REG_T2));
+	code.push_back(cache(CACHE_IIndexLoadData | CACHE_D, REG_T0, 0));
+	code.push_back(reg(CMD_SLTU, REG_AT, REG_T0, REG_T1));
+	code.push_back(branch(CMD_BNE, REG_AT, REG_R0, -3));
+	code.push_back(imm(CMD_ADDIU, REG_T0, REG_T0, 0x10));
+	appendDCacheWholeCache(code);
+
+	begin(PLANTED_OS_WRITEBACK_DCACHE);
+	for (const auto &inst : code)
+		emit(inst);
+}
+
+// Some builds have an extra NOP before the signature
+void Generator::emitInvalDCache()
+{
+	std::vector<Instruction> code;
+	appendDCacheChecks(code);
+	code.push_back(nop());
+	if (chance(50))
+		code.push_back(nop());
+
+	code.push_back(reg(CMD_SUBU, REG_T0, REG_T0, REG_T2));
+	code.push_back(cache(CACHE_CacheBarrier | CACHE_D, REG_T0, 0));
+	code.push_back(reg(CMD_SLTU, REG_AT, REG_T0, REG_T1));
+	code.push_back(branch(CMD_BEQ, REG_AT, REG_R0, 0xe));
+	code.push_back(nop());
+	code.push_back(imm(CMD_ADDIU, REG_T0, REG_T0, 0x10));
+	code.push_back(imm(CMD_ANDI, REG_T2, REG_T1, 0xf));
+	code.push_back(branch(CMD_BEQ, REG_T2, REG_R0, 6));
+	code.push_back(nop());
+	code.push_back(reg(CMD_SUBU, REG_T1, REG_T1, REG_T2));
+	code.push_back(cache(CACHE_CacheBarrier | CACHE_D, REG_T1, 0x10));
+	code.push_back(reg(CMD_SLTU, REG_AT, REG_T1, REG_T0));
+	code.push_back(branch(CMD_BNE, REG_AT, REG_R0, 5));
+	code.push_back(nop());
+	code.push_back(cache(CACHE_IHitInvalidate | CACHE_D, REG_T0, 0));
+	code.push_back(reg(CMD_SLTU, REG_AT, REG_T0, REG_T1));
+	code.push_back(branch(CMD_BNE, REG_AT, REG_R0, -3));
+	code.push_back(imm(CMD_ADDIU, REG_T0, REG_T0, 0x10));
+	appendDCacheWholeCache(code);
+
+	begin(PLANTED_OS_INVAL_DCACHE);
+	for (const auto &inst : code)
+		emit(inst);
+}
+
+void Generator::emitGetTime()
+{
+	uint32_t currentTime = dataAddress(2);
+	begin(PLANTED_OS_GET_TIME);
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, -0x28));
+	emit(mem(CMD_SW, REG_RA, 0x24, REG_SP));
+	emit(mem(CMD_SW, REG_S1, 0x20, REG_SP));
+	call(PLANTED_OS_DISABLE_INT);
+	emit(mem(CMD_SW, REG_S0, 0x1c, REG_SP));
+	emit(reg(CMD_OR, REG_S1, REG_V0, REG_R0));
+	call(PLANTED_OS_GET_COUNT);
+	emit(nop());
+	emit(lui(REG_T6, hi(currentTime)));
+	emit(mem(CMD_LW, REG_T6, lo(currentTime), REG_T6));
+	emit(reg(CMD_SUBU, REG_T7, REG_V0, REG_T6));
+	emit(reg(CMD_OR, REG_S0, REG_T7, REG_R0));
+	call(PLANTED_OS_RESTORE_INT);
+	emit(reg(CMD_OR, REG_A0, REG_S1, REG_R0));
+	emit(reg(CMD_OR, REG_V0, REG_S0, REG_R0));
+	emit(mem(CMD_LW, REG_RA, 0x24, REG_SP));
+	emit(mem(CMD_LW, REG_S0, 0x1c, REG_SP));
+	emit(mem(CMD_LW, REG_S1, 0x20, REG_SP));
+	emit(jr(REG_RA));
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, 0x28));
+}
+
+// Up to 4 words may precede the prolog, the analyzer tries each of them
+void Generator::emitSiRawStartDma()
+{
+	uint32_t accessQueue = dataAddress(1);
+	begin(PLANTED_OS_SI_RAW_START_DMA);
+	uint32_t prefix = below(5);
+	if (prefix > 0)
+		emit(lui(REG_T8, hi(accessQueue)));
+	if (prefix > 1)
+		emit(mem(CMD_LW, REG_T8, lo(accessQueue), REG_T8));
+	for (uint32_t i = 2; i < prefix; i++)
+		emit(nop());
+
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, -0x18));
+	emit(mem(CMD_SW, REG_RA, 0x14, REG_SP));
+	emit(mem(CMD_SW, REG_A0, 0x18, REG_SP));
+	emit(mem(CMD_SW, REG_A1, 0x1c, REG_SP));
+	emit(mem(CMD_LW, REG_T6, 0x18, REG_SP));
+	emit(branch(CMD_BNE, REG_T6, REG_R0, 3));
+	emit(nop());
+	emit(mem(CMD_LW, REG_A0, 0x1c, REG_SP));
+	call(PLANTED_OS_WRITEBACK_DCACHE);
+	emit(imm(CMD_ADDIU, REG_A1, REG_R0, 0x40));
+	emit(mem(CMD_LW, REG_A0, 0x1c, REG_SP));
+	call(PLANTED_OS_VIRTUAL_TO_PHYSICAL);
+	emit(nop());
+	emit(lui(REG_T7, 0xa480));
+	emit(mem(CMD_SW, REG_V0, 0, REG_T7));
+	emit(mem(CMD_LW, REG_A0, 0x1c, REG_SP));
+	call(PLANTED_OS_INVAL_DCACHE);
+	emit(imm(CMD_ADDIU, REG_A1, REG_R0, 0x40));
+	emit(mem(CMD_LW, REG_RA, 0x14, REG_SP));
+	emit(reg(CMD_OR, REG_V0, REG_R0, REG_R0));
+	emit(jr(REG_RA));
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, 0x18));
+}
+
+// Writes the PIF request with __osSiRawStartDma and reads the reply back,
+// both calls get __osContPifRam in A1
+void Generator::emitContInit()
+{
+	uint32_t initialized = dataAddress(1);
+	begin(PLANTED_OS_CONT_INIT);
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, -0x78));
+	emit(mem(CMD_SW, REG_RA, 0x24, REG_SP));
+	emit(mem(CMD_SW, REG_S0, 0x20, REG_SP));
+	emit(mem(CMD_SW, REG_A0, 0x78, REG_SP));
+	emit(mem(CMD_SW, REG_A1, 0x7c, REG_SP));
+	emit(mem(CMD_SW, REG_A2, 0x80, REG_SP));
+	emit(lui(REG_T6, hi(initialized)));
+	emit(imm(CMD_ADDIU, REG_T7, REG_R0, 1));
+	emit(mem(CMD_SW, REG_T7, lo(initialized), REG_T6));
+	call(PLANTED_OS_GET_TIME);
+	emit(nop());
+	emit(reg(CMD_OR, REG_S0, REG_V0, REG_R0));
+	// Without branches, they could land between the argument setup of the
+	// calls below and their JALs which compiled code never does
+	for (uint32_t i = below(8); i; i--)
+		emitFillerOp(false, 0x78, false);
+
+	for (int write = 1; write >= 0; write--) {
+		emit(imm(CMD_ADDIU, REG_A0, REG_R0, write));
+		emit(lui(REG_A1, hi(osContPifRam_)));
+		call(PLANTED_OS_SI_RAW_START_DMA);
+		emit(imm(CMD_ADDIU, REG_A1, REG_A1, lo(osContPifRam_)));
+		emit(mem(CMD_LW, REG_A0, 0x78, REG_SP));
+		emit(reg(CMD_OR, REG_A1, REG_R0, REG_R0));
+		// osRecvMesg in the real thing, any function will do
+		if (starts_.size() > PLANTED_COUNT)
+			call(PLANTED_COUNT +
+			     below(static_cast<uint32_t>(starts_.size() -
+							 PLANTED_COUNT)));
+		else
+			emit(nop());
+		emit(imm(CMD_ADDIU, REG_A2, REG_R0, 1));
+	}
+
+	emit(mem(CMD_LW, REG_RA, 0x24, REG_SP));
+	emit(mem(CMD_LW, REG_S0, 0x20, REG_SP));
+	emit(jr(REG_RA));
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, 0x78));
+}
+
+// Game code keeping gControllerPads and the status next to each other and
+// the message queue osContInit gets wherever it is, all in GP relative
+// globals
+void Generator::emitControllerInit()
+{
+	uint32_t queue = controllerQueue_;
+	begin(PLANTED_CONTROLLER_INIT);
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, -0x20));
+	emit(mem(CMD_SW, REG_RA, 0x14, REG_SP));
+	for (uint32_t i = below(4); i; i--)
+		emit(reg(pick(sFillerAlu), REG_T0, anyRegister(),
+			 anyRegister()));
+
+	emit(lui(REG_T6, hi(gControllerPads_)));
+	emit(imm(CMD_ADDIU, REG_T6, REG_T6, lo(gControllerPads_)));
+	emit(mem(CMD_SW, REG_T6, -0x8000 + static_cast<int>(below(0x1000) << 2),
+		 REG_GP));
+	emit(lui(REG_A2, hi(controllerStatus_)));
+	emit(imm(CMD_ADDIU, REG_A2, REG_A2, lo(controllerStatus_)));
+	emit(mem(CMD_SW, REG_A2, -0x4000 + static_cast<int>(below(0x1000) << 2),
+		 REG_GP));
+	emit(lui(REG_T7, hi(queue)));
+	emit(imm(CMD_ADDIU, REG_T7, REG_T7, lo(queue)));
+	emit(mem(CMD_SW, REG_T7, static_cast<int>(below(0x1000) << 2),
+		 REG_GP));
+	emit(reg(CMD_OR, REG_A0, REG_T7, REG_R0));
+	osContInitCall_ = static_cast<int>(cursor_);
+	call(PLANTED_OS_CONT_INIT);
+	emit(imm(CMD_ADDIU, REG_A1, REG_SP, 0x1f));
+	emit(mem(CMD_LW, REG_RA, 0x14, REG_SP));
+	emit(jr(REG_RA));
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, 0x20));
+}
+
+// The retrace handling of the VI manager thread: counts the retrace, then
+// advances the system time by the cycles since the last one
+void Generator::emitViMgrMain()
+{
+	uint32_t baseCounter = dataAddress(1);
+	uint32_t currentTime = dataAddress(2);
+	begin(PLANTED_VI_MGR_MAIN);
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, -0x28));
+	emit(mem(CMD_SW, REG_RA, 0x1c, REG_SP));
+	emit(mem(CMD_SW, REG_S0, 0x18, REG_SP));
+	for (uint32_t i = below(8); i; i--)
+		emitFillerOp(true, 0x28, false);
+
+	// The compiler either reloads the upper half into AT for the store or
+	// keeps the address in one register
+	if (chance(50)) {
+		emit(lui(REG_T6, hi(viIntrCount_)));
+		emit(mem(CMD_LW, REG_T6, lo(viIntrCount_), REG_T6));
+		emit(lui(REG_AT, hi(viIntrCount_)));
+		emit(imm(CMD_ADDIU, REG_T7, REG_T6, 1));
+		emit(mem(CMD_SW, REG_T7, lo(viIntrCount_), REG_AT));
+	} else {
+		emit(lui(REG_AT, hi(viIntrCount_)));
+		emit(mem(CMD_LW, REG_T6, lo(viIntrCount_), REG_AT));
+		emit(imm(CMD_ADDIU, REG_T6, REG_T6, 1));
+		emit(mem(CMD_SW, REG_T6, lo(viIntrCount_), REG_AT));
+	}
+
+	emit(lui(REG_T8, hi(baseCounter)));
+	call(PLANTED_OS_GET_COUNT);
+	emit(mem(CMD_LW, REG_S0, lo(baseCounter), REG_T8));
+	emit(lui(REG_T9, hi(baseCounter)));
+	emit(mem(CMD_SW, REG_V0, lo(baseCounter), REG_T9));
+	emit(reg(CMD_SUBU, REG_T0, REG_V0, REG_S0));
+	emit(lui(REG_T1, hi(currentTime + 4)));
+	emit(mem(CMD_LW, REG_T2, lo(currentTime + 4), REG_T1));
+	emit(reg(CMD_ADDU, REG_T2, REG_T2, REG_T0));
+	emit(mem(CMD_SW, REG_T2, lo(currentTime + 4), REG_T1));
+	emit(mem(CMD_LW, REG_RA, 0x1c, REG_SP));
+	emit(mem(CMD_LW, REG_S0, 0x18, REG_SP));
+	emit(jr(REG_RA));
+	emit(imm(CMD_ADDIU, REG_SP, REG_SP, 0x28));
+}
+
+SyntheticRAM Generator::generate()
+{
+	// Game and libultra code in the first MB, expansion pak images get an
+	// overlay segment above 4 MB holding the game side
+	text_.push_back({0x100, 0x40000});
+	if (ram_.size() > 0x100000)
+		text_.push_back({0x100000 + (below(0x100) << 8), 0});
+	if (text_.size() > 1)
+		text_[1].end = text_[1].begin + 0x20000;
+
+	gControllerPads_ = dataAddress(0x100);
+	controllerStatus_ = gControllerPads_ + 0x18 + (below(0x40) << 2);
+	// Some games declare the queue right after the status, closer to it
+	// than the pads are, others keep it anywhere
+	if (chance(50))
+		controllerQueue_ = controllerStatus_ + 0x10 + (below(4) << 2);
+	else
+		controllerQueue_ = dataAddress(6);
+	osContPifRam_ = dataAddress(0x10);
+	gp_ = dataAddress(0x4000) + 0x8000;
+	viIntrCount_ = dataAddress(1);
+
+	fillVectors();
+	fillData();
+	// Left in osMemSize by the boot code
+	ram_[(OsMemSize & 0xffffff) >> 2] =
+		static_cast<uint32_t>(ram_.size() * sizeof(uint32_t));
+	fillControllerData();
+
+	std::vector<Planted> libultra = {
+		PLANTED_OS_GET_COUNT,        PLANTED_OS_DISABLE_INT,
+		PLANTED_OS_RESTORE_INT,      PLANTED_OS_WRITEBACK_DCACHE,
+		PLANTED_OS_INVAL_DCACHE,     PLANTED_OS_VIRTUAL_TO_PHYSICAL,
+		PLANTED_OS_GET_TIME,         PLANTED_OS_SI_RAW_START_DMA,
+		PLANTED_OS_CONT_INIT,        PLANTED_GPR_SETUP,
+		PLANTED_VI_MGR_MAIN,
+	};
+	if (text_.size() > 1 && chance(50)) {
+		fillText(text_[0], libultra);
+		fillText(text_[1], {PLANTED_CONTROLLER_INIT});
+	} else {
+		libultra.push_back(PLANTED_CONTROLLER_INIT);
+		fillText(text_[0], libultra);
+		if (text_.size() > 1)
+			fillText(text_[1], {});
+	}
+
+	for (const auto &site : calls_)
+		ram_[site.first] = ToUInt(jal(starts_[site.second]));
+
+	static const char *const sNames[PLANTED_COUNT] = {
+		"osGetCount",          "__osDisableInt",
+		"__osRestoreInt",      "osWritebackDCache",
+		"osInvalDCache",       "osVirtualToPhysical",
+		"osGetTime",           "__osSiRawStartDma",
+		"osContInit",          "GPR setup",
+		"controller init",     "viMgrMain",
+	};
+
+	SyntheticRAM ret;
+	ret.ram = std::move(ram_);
+	ret.gControllerPads = gControllerPads_;
+	ret.osContInitCall = osContInitCall_;
+	ret.controllerStatus = controllerStatus_;
+	ret.osContPifRam = osContPifRam_;
+	ret.gp = gp_;
+	ret.viIntrCount = viIntrCount_;
+	for (size_t i = 0; i < PLANTED_COUNT; i++)
+		ret.symbols.push_back(
+			{sNames[i], static_cast<int>(starts_[i])});
+
+	return ret;
+}
+
+SyntheticRAM GenerateSyntheticRAM(uint32_t seed,
+				  const SyntheticOptions &options)
+{
+	Generator generator(seed, options);
+	return generator.generate();
+}
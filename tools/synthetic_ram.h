@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Builds RDRAM images with the libultra code MIPS::analyze looks for planted
+// at random offsets among generated game code, so the analyzer can be
+// measured without commercial ROM dumps. The same seed and options always
+// produce the same image.
+
+struct SyntheticOptions {
+	// 0x100000 words for 4 MB, 0x200000 for the expansion pak layout
+	size_t words = 0x100000;
+};
+
+// Where libultra keeps the RDRAM size, every image has it set
+static const uint32_t OsMemSize = 0x80000318;
+
+struct SyntheticSymbol {
+	std::string name;
+	int offset;
+};
+
+struct SyntheticRAM {
+	std::vector<uint32_t> ram;
+
+	// Ground truth for what 'analyze' should report
+	uint32_t gControllerPads;
+	// JAL to osContInit that receives the controller status
+	int osContInitCall;
+
+	uint32_t controllerStatus;
+	uint32_t osContPifRam;
+	uint32_t gp;
+	// Counter viMgrMain increments on every retrace
+	uint32_t viIntrCount;
+	// Word offsets of every planted function
+	std::vector<SyntheticSymbol> symbols;
+};
+
+SyntheticRAM GenerateSyntheticRAM(uint32_t seed,
+				  const SyntheticOptions &options = {});